@@ -0,0 +1,59 @@
+#include "openglcontext.h"
+#include "texture.h"
+
+// OpenGLContext and Texture for benchmarks built against the stand-in
+// Qt GL headers in this directory, in place of openglcontext.cpp and
+// texture.cpp, which need Qt's GUI and widget modules. There is no GL
+// state to cache, so the cache only keeps its counters at zero.
+
+OpenGLContext::OpenGLContext(QWidget *parent)
+    : QOpenGLWidget(parent),
+      m_boundProgram(UNKNOWN_BINDING), m_boundArrayBuffer(UNKNOWN_BINDING),
+      m_boundVertexArray(UNKNOWN_BINDING), m_activeTextureSlot(UNKNOWN_BINDING),
+      m_boundTextures(), m_glStateStats()
+{
+    m_boundTextures.fill(UNKNOWN_BINDING);
+}
+
+OpenGLContext::~OpenGLContext()
+{}
+
+void OpenGLContext::debugContextVersion() {}
+void OpenGLContext::printGLErrorLog() {}
+void OpenGLContext::printLinkInfoLog(int) {}
+void OpenGLContext::printShaderInfoLog(int) {}
+
+void OpenGLContext::useProgram(GLuint) {}
+void OpenGLContext::bindArrayBuffer(GLuint) {}
+void OpenGLContext::bindVertexArray(GLuint) {}
+void OpenGLContext::bindTexture2D(GLuint, GLuint) {}
+void OpenGLContext::forgetArrayBuffer(GLuint) {}
+void OpenGLContext::invalidateGLState() {}
+void OpenGLContext::countUniformUpload(bool) {}
+
+const GLStateStats& OpenGLContext::glStateStats() const {
+    return m_glStateStats;
+}
+
+void OpenGLContext::resetGLStateStats() {
+    m_glStateStats = GLStateStats();
+}
+
+int GLStateStats::total() const {
+    return 0;
+}
+
+int GLStateStats::skipped() const {
+    return 0;
+}
+
+Texture::Texture(OpenGLContext *context)
+    : context(context), m_textureHandle(0), m_textureImage(nullptr)
+{}
+
+Texture::~Texture()
+{}
+
+void Texture::create(const char *) {}
+void Texture::load(GLuint) {}
+void Texture::bind(GLuint) {}
@@ -0,0 +1,349 @@
+#include "scene/chunkworkers.h"
+#include "scene/zonefieldcache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+
+// Compares the meshing kernel that looks up each block's six
+// neighbors one at a time with getBlockAt (the one meshing used
+// before ChunkFaceMasks, kept to the current rules for merging
+// faces) against the current bitmask kernel. Both mesh the same
+// fixed region of generated terrain on one thread, in each
+// MeshingMode, and the throughput of each is reported in chunks
+// per second. The two kernels must build the same faces: greedy
+// meshes byte for byte, and per-face meshes face for face.
+// Exits with 1 if they don't.
+//
+// Usage: meshbench [--zones N] [--seed S]
+// The region is the N x N zones with a corner at the origin (2 x 2
+// by default). Without --seed the world uses the sin hash noise
+// backend (the game's default), with it the integer hash backend
+// and that seed.
+
+using Clock = std::chrono::steady_clock;
+
+// Each kernel meshes the whole region, repeatedly, until
+// it has run for at least this many seconds
+#define MIN_TIMING_SECONDS 0.5
+
+// The block at chunk-local (x, y, z) of snapshot, which may be in
+// the one-block border. Above and below the Chunk is EMPTY.
+static BlockType getBlockAt(const ChunkBlockSnapshot &snapshot, int x, int y, int z) {
+    if (y < 0 || y >= 256) {
+        return EMPTY;
+    }
+    if (x < 0) {
+        return snapshot.m_borders[XNEG][z + 16 * y];
+    }
+    if (x >= 16) {
+        return snapshot.m_borders[XPOS][z + 16 * y];
+    }
+    if (z < 0) {
+        return snapshot.m_borders[ZNEG][x + 16 * y];
+    }
+    if (z >= 16) {
+        return snapshot.m_borders[ZPOS][x + 16 * y];
+    }
+    return snapshot.m_blocks[blockIndex(x, y, z)];
+}
+
+static bool faceIsHidden(BlockType curr, BlockType adj) {
+    // Transparent blocks only show faces that touch EMPTY,
+    // and opaque blocks show faces that touch anything transparent
+    if (isTransparent(curr)) {
+        return adj != EMPTY;
+    }
+    return !isTransparent(adj);
+}
+
+static bool sectionMayHaveFaces(const ChunkBlockSnapshot &snapshot, int section) {
+    if (!snapshot.m_uniformSections[section]) {
+        return true;
+    }
+    int minY = 16 * section, maxY = minY + 15;
+    BlockType t = snapshot.m_blocks[blockIndex(0, minY, 0)];
+    if (t == EMPTY) {
+        return false;
+    }
+    // Every face of a uniform section is interior except those on its
+    // boundary, so only the blocks just outside its six sides matter
+    for (int a = 0; a < 16; ++a) {
+        for (int b = 0; b < 16; ++b) {
+            if (!faceIsHidden(t, getBlockAt(snapshot, a, minY - 1, b)) ||
+                !faceIsHidden(t, getBlockAt(snapshot, a, maxY + 1, b)) ||
+                !faceIsHidden(t, getBlockAt(snapshot, -1, minY + a, b)) ||
+                !faceIsHidden(t, getBlockAt(snapshot, 16, minY + a, b)) ||
+                !faceIsHidden(t, getBlockAt(snapshot, b, minY + a, -1)) ||
+                !faceIsHidden(t, getBlockAt(snapshot, b, minY + a, 16))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// The getBlockAt kernel's PER_FACE_MESHING
+static void getBlockAtPerFace(ChunkVBOData &c, const ChunkBlockSnapshot &snapshot) {
+    for (int s = 0; s < 16; ++s) {
+        if (!sectionMayHaveFaces(snapshot, s)) {
+            continue;
+        }
+        for (int y = 16 * s; y < 16 * s + 16; ++y) {
+            for (int z = 0; z < 16; ++z) {
+                for (int x = 0; x < 16; ++x) {
+                    BlockType curr = snapshot.m_blocks[blockIndex(x, y, z)];
+                    if (curr == EMPTY) {
+                        continue;
+                    }
+                    for (const BlockFace &f : adjacentFaces) {
+                        BlockType adj = getBlockAt(snapshot, x + f.directionVec.x,
+                                                   y + f.directionVec.y, z + f.directionVec.z);
+                        if (faceIsHidden(curr, adj)) {
+                            continue;
+                        }
+                        vector<GLuint> &vbo = isTransparent(curr) ? c.m_vboDataTransparent : c.m_vboDataOpaque;
+                        VBOWorker::appendVBOData(vbo, f, curr, ivec3(x, y, z), ivec3(1));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// The getBlockAt kernel's GREEDY_MESHING
+static void getBlockAtGreedy(ChunkVBOData &c, const ChunkBlockSnapshot &snapshot) {
+    array<bool, 16> sectionHasFaces;
+    for (int s = 0; s < 16; ++s) {
+        sectionHasFaces[s] = sectionMayHaveFaces(snapshot, s);
+    }
+    const ivec3 dims(16, 256, 16);
+    // One slice of the Chunk perpendicular to a face direction. Each
+    // entry is the BlockType whose face is visible there, or EMPTY.
+    vector<BlockType> mask(16 * 256);
+
+    for (const BlockFace &f : adjacentFaces) {
+        int n = f.directionVec.x != 0 ? 0 : (f.directionVec.y != 0 ? 1 : 2);
+        int u = n == 0 ? 2 : 0;
+        int v = n == 1 ? 2 : 1;
+        int dimU = dims[u], dimV = dims[v];
+
+        for (int slice = 0; slice < dims[n]; ++slice) {
+            if (n == 1 && !sectionHasFaces[slice / 16]) {
+                continue;
+            }
+            // Find the visible faces in this slice
+            bool anyFaces = false;
+            for (int j = 0; j < dimV; ++j) {
+                for (int i = 0; i < dimU; ++i) {
+                    ivec3 p;
+                    p[n] = slice;
+                    p[u] = i;
+                    p[v] = j;
+                    BlockType curr = EMPTY;
+                    if (sectionHasFaces[p.y / 16]) {
+                        curr = snapshot.m_blocks[blockIndex(p.x, p.y, p.z)];
+                        if (curr != EMPTY) {
+                            ivec3 q = p + f.directionVec;
+                            if (faceIsHidden(curr, getBlockAt(snapshot, q.x, q.y, q.z))) {
+                                curr = EMPTY;
+                            }
+                        }
+                    }
+                    mask[i + dimU * j] = curr;
+                    anyFaces |= curr != EMPTY;
+                }
+            }
+            if (!anyFaces) {
+                continue;
+            }
+
+            // Grow each rectangle along u, then along v, exactly
+            // as VBOWorker::buildGreedyVBOData does
+            for (int j = 0; j < dimV; ++j) {
+                for (int i = 0; i < dimU; ) {
+                    BlockType curr = mask[i + dimU * j];
+                    if (curr == EMPTY) {
+                        ++i;
+                        continue;
+                    }
+                    // Faces of transparent blocks are never merged
+                    int w = 1, h = 1;
+                    if (!isTransparent(curr)) {
+                        while (i + w < dimU && mask[i + w + dimU * j] == curr) {
+                            ++w;
+                        }
+                        for (; j + h < dimV; ++h) {
+                            bool rowMatches = true;
+                            for (int k = 0; k < w; ++k) {
+                                if (mask[i + k + dimU * (j + h)] != curr) {
+                                    rowMatches = false;
+                                    break;
+                                }
+                            }
+                            if (!rowMatches) {
+                                break;
+                            }
+                        }
+                    }
+                    for (int dj = 0; dj < h; ++dj) {
+                        std::fill_n(mask.begin() + i + dimU * (j + dj), w, EMPTY);
+                    }
+
+                    ivec3 origin, extent(1);
+                    origin[n] = slice;
+                    origin[u] = i;
+                    origin[v] = j;
+                    extent[u] = w;
+                    extent[v] = h;
+                    vector<GLuint> &vbo = isTransparent(curr) ? c.m_vboDataTransparent : c.m_vboDataOpaque;
+                    VBOWorker::appendVBOData(vbo, f, curr, origin, extent);
+                    i += w;
+                }
+            }
+        }
+    }
+}
+
+// Meshes c with one kernel in one MeshingMode, snapshot included
+static ChunkVBOData meshChunk(Chunk *c, bool bitmasks, MeshingMode mode) {
+    ChunkVBOData d(c, c->getNeighbors());
+    ChunkBlockSnapshot snapshot(c, d.mp_neighbors);
+    if (bitmasks) {
+        ChunkFaceMasks masks(snapshot);
+        if (mode == GREEDY_MESHING) {
+            VBOWorker::buildGreedyVBOData(d, snapshot, masks);
+        }
+        else {
+            VBOWorker::buildPerFaceVBOData(d, snapshot, masks);
+        }
+    }
+    else if (mode == GREEDY_MESHING) {
+        getBlockAtGreedy(d, snapshot);
+    }
+    else {
+        getBlockAtPerFace(d, snapshot);
+    }
+    return d;
+}
+
+// The quads of vbo, each as the words of its four vertices, sorted
+static vector<vector<GLuint>> sortedQuads(const vector<GLuint> &vbo) {
+    const size_t quadWords = 4 * CHUNK_VERTEX_WORDS;
+    vector<vector<GLuint>> quads;
+    for (size_t i = 0; i + quadWords <= vbo.size(); i += quadWords) {
+        quads.emplace_back(vbo.begin() + i, vbo.begin() + i + quadWords);
+    }
+    std::sort(quads.begin(), quads.end());
+    return quads;
+}
+
+// Whether the two kernels built the same mesh in mode
+static bool sameMesh(const ChunkVBOData &a, const ChunkVBOData &b, MeshingMode mode) {
+    if (mode == GREEDY_MESHING) {
+        return a.m_vboDataOpaque == b.m_vboDataOpaque && a.m_vboDataTransparent == b.m_vboDataTransparent;
+    }
+    // The kernels visit the faces of a block in different orders
+    return sortedQuads(a.m_vboDataOpaque) == sortedQuads(b.m_vboDataOpaque) &&
+           sortedQuads(a.m_vboDataTransparent) == sortedQuads(b.m_vboDataTransparent);
+}
+
+// Chunks per second of one kernel over every Chunk of chunks
+static double chunksPerSecond(const vector<Chunk*> &chunks, bool bitmasks, MeshingMode mode) {
+    size_t meshed = 0, vertices = 0;
+    Clock::time_point start = Clock::now();
+    double seconds = 0.0;
+    do {
+        for (Chunk *c : chunks) {
+            ChunkVBOData d = meshChunk(c, bitmasks, mode);
+            vertices += d.m_vboDataOpaque.size() + d.m_vboDataTransparent.size();
+        }
+        meshed += chunks.size();
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (seconds < MIN_TIMING_SECONDS);
+    // Keeps the meshes from being optimized away
+    if (vertices == 0) {
+        std::printf("(no vertices)\n");
+    }
+    return meshed / seconds;
+}
+
+int main(int argc, char **argv) {
+    int zones = 2;
+    WorldNoise noise;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--zones" && i + 1 < argc) {
+            zones = std::atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            noise = WorldNoise(INTEGER_HASH_NOISE, std::strtoull(argv[++i], nullptr, 0));
+        }
+        else {
+            zones = 0;
+            break;
+        }
+    }
+    if (zones < 1) {
+        std::fprintf(stderr, "usage: %s [--zones N] [--seed S]\n", argv[0]);
+        return 1;
+    }
+
+    // Every Chunk of the region, linked to its neighbors as Terrain would
+    unordered_map<int64_t, uPtr<Chunk>> chunks;
+    for (int x = 0; x < 64 * zones; x += 16) {
+        for (int z = 0; z < 64 * zones; z += 16) {
+            chunks[toKey(x, z)] = mkU<Chunk>(nullptr, x, z);
+        }
+    }
+    for (auto &kvp : chunks) {
+        ivec2 coords = toCoords(kvp.first);
+        auto north = chunks.find(toKey(coords.x, coords.y + 16));
+        if (north != chunks.end()) {
+            kvp.second->linkNeighbor(north->second, ZPOS);
+        }
+        auto east = chunks.find(toKey(coords.x + 16, coords.y));
+        if (east != chunks.end()) {
+            kvp.second->linkNeighbor(east->second, XPOS);
+        }
+    }
+
+    // Generate it on this thread, in a fixed order
+    ZoneFieldCache fieldCache(noise);
+    std::unordered_set<Chunk*> generated;
+    QMutex generatedLock;
+    vector<Chunk*> region;
+    for (int x = 0; x < 64 * zones; x += 16) {
+        for (int z = 0; z < 64 * zones; z += 16) {
+            Chunk *c = chunks[toKey(x, z)].get();
+            FBMWorker(c, noise, &fieldCache, &generated, &generatedLock).run();
+            region.push_back(c);
+        }
+    }
+
+    const char *backend = noise.backend == SIN_HASH_NOISE ? "sin hash" : "integer hash";
+    std::printf("%d x %d zones (%zu chunks) from (0, 0), %s noise, seed %llu, 1 thread\n",
+                zones, zones, region.size(), backend, static_cast<unsigned long long>(noise.seed));
+    std::printf("%-10s %16s %16s %10s %s\n", "mode", "getBlockAt (c/s)", "bitmasks (c/s)", "speedup", "check");
+
+    int failures = 0;
+    for (MeshingMode mode : {GREEDY_MESHING, PER_FACE_MESHING}) {
+        bool same = true;
+        for (Chunk *c : region) {
+            same = same && sameMesh(meshChunk(c, false, mode), meshChunk(c, true, mode), mode);
+        }
+        failures += !same;
+        double before = chunksPerSecond(region, false, mode);
+        double after = chunksPerSecond(region, true, mode);
+        std::printf("%-10s %16.1f %16.1f %9.2fx %s\n", mode == GREEDY_MESHING ? "greedy" : "per-face",
+                    before, after, after / before, same ? "ok" : "FAILED");
+    }
+    std::printf("c/s is chunks meshed per second, snapshot included\n");
+    if (failures != 0) {
+        std::printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "scene/noise_functions.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Evaluates the five 2D fields FBMWorker needs for every column
+// (the biome value and the four biome heights) over a square of
+// terrain zones, and reports how many columns per second each
+// noise backend manages.
+//
+// Usage: noisebench [zones per side] [seed]
+
+using Clock = std::chrono::steady_clock;
+
+// Sum of every value computed, printed so the work can't be optimized
+// away, and so runs on different machines can be compared
+struct ColumnResult {
+    double columnsPerSecond;
+    double checksum;
+};
+
+// One column at a time, through the single-point functions
+static ColumnResult runSingle(int zonesPerSide) {
+    double checksum = 0.0;
+    Clock::time_point start = Clock::now();
+    for (int x = 0; x < zonesPerSide * 64; ++x) {
+        for (int z = 0; z < zonesPerSide * 64; ++z) {
+            vec2 p(x, z);
+            vec2 biome = biomeValue(p / 750.f);
+            checksum += biome.x + biome.y + grasslandValue(p) + desertValue(p)
+                    + mountainValue(p) + islandValue(p);
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return {zonesPerSide * 64.0 * zonesPerSide * 64.0 / seconds, checksum};
+}
+
+// A Chunk row of NOISE_BATCH_SIZE columns at a time, as FBMWorker does
+static ColumnResult runBatch(int zonesPerSide) {
+    double checksum = 0.0;
+    vec2 row[NOISE_BATCH_SIZE], biomeUV[NOISE_BATCH_SIZE], biome[NOISE_BATCH_SIZE];
+    float heights[4][NOISE_BATCH_SIZE];
+    Clock::time_point start = Clock::now();
+    for (int x = 0; x < zonesPerSide * 64; x += NOISE_BATCH_SIZE) {
+        for (int z = 0; z < zonesPerSide * 64; ++z) {
+            for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                row[i] = vec2(x + i, z);
+                biomeUV[i] = row[i] / 750.f;
+            }
+            biomeValueBatch(biomeUV, biome);
+            grasslandValueBatch(row, heights[0]);
+            desertValueBatch(row, heights[1]);
+            mountainValueBatch(row, heights[2]);
+            islandValueBatch(row, heights[3]);
+            for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                checksum += biome[i].x + biome[i].y + heights[0][i] + heights[1][i]
+                        + heights[2][i] + heights[3][i];
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return {zonesPerSide * 64.0 * zonesPerSide * 64.0 / seconds, checksum};
+}
+
+int main(int argc, char **argv) {
+    int zonesPerSide = argc > 1 ? std::atoi(argv[1]) : 2;
+    uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 0) : 0;
+    if (zonesPerSide < 1) {
+        std::fprintf(stderr, "usage: %s [zones per side] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%d x %d zones (%d columns), seed %llu\n", zonesPerSide, zonesPerSide,
+                zonesPerSide * zonesPerSide * 64 * 64, static_cast<unsigned long long>(seed));
+    std::printf("%-20s %-8s %16s %20s\n", "backend", "mode", "columns/s", "checksum");
+
+    const struct {
+        const char *name;
+        WorldNoise noise;
+    } backends[] = {
+        {"sin hash", WorldNoise(SIN_HASH_NOISE)},
+        {"integer hash", WorldNoise(INTEGER_HASH_NOISE, seed)},
+    };
+    for (const auto &backend : backends) {
+        WorldNoiseScope scope(backend.noise);
+        ColumnResult single = runSingle(zonesPerSide);
+        ColumnResult batch = runBatch(zonesPerSide);
+        std::printf("%-20s %-8s %16.0f %20.6f\n", backend.name, "single", single.columnsPerSecond, single.checksum);
+        std::printf("%-20s %-8s %16.0f %20.6f\n", backend.name, "batch", batch.columnsPerSecond, batch.checksum);
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+# Headless benchmark of the terrain noise functions.
+# Build and run it from a shadow build directory:
+#   qmake path/to/noisebench.pro && make && ./noisebench
+
+TARGET = noisebench
+TEMPLATE = app
+CONFIG += console c++1z release
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../../include ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/scene/noise_functions.cpp
+
+HEADERS += \
+    ../../src/scene/noise_functions.h
@@ -0,0 +1,54 @@
+#pragma once
+#include "scene/noise_functions.h"
+
+// Values of every noise primitive on noisemicrobench's grid, recorded
+// from the reference implementation. Regenerate the table with
+// noisemicrobench --print-golden only when the world is meant to change.
+// The sin hash backend's values depend on the platform's sin(), which
+// GOLDEN_TOLERANCE allows for.
+
+// The grid: GOLDEN_GRID_SIZE x GOLDEN_GRID_SIZE world-space columns,
+// starting at (GOLDEN_GRID_ORIGIN, GOLDEN_GRID_ORIGIN)
+#define GOLDEN_GRID_SIZE 64
+#define GOLDEN_GRID_ORIGIN -32
+// Seed of the integer hash backend
+#define GOLDEN_SEED 0x5eedULL
+// Largest relative difference from a golden value that still passes
+#define GOLDEN_TOLERANCE 1e-4
+
+struct NoiseGolden {
+    const char *name;
+    NoiseBackend backend;
+    // Mean over the whole grid
+    double mean;
+    // The first sample, those a third and two thirds of the
+    // way through the grid, and the last
+    float samples[4];
+};
+
+static const NoiseGolden s_noiseGoldens[] = {
+    {"perlinNoise(vec2)", SIN_HASH_NOISE, -0.0137278378, {0, 0.130015597, -0.173202381, -0.0261898302}},
+    {"perlinNoise(vec3)", SIN_HASH_NOISE, -0.00323245924, {0, -0.00242713094, 0.146593288, -0.146615148}},
+    {"fbm", SIN_HASH_NOISE, 0.399552644, {0.548095703, 0.459185302, 0.190395996, 0.381392121}},
+    {"fractalPerlin", SIN_HASH_NOISE, 0.923260739, {0.940307617, 0.925013483, 0.940200031, 0.906567097}},
+    {"mountainSummedPerlin", SIN_HASH_NOISE, 0.921347036, {0.884470284, 0.937637985, 0.950996518, 0.880814731}},
+    {"worleyNoise2Point", SIN_HASH_NOISE, 0.130793356, {0.152476281, 0.18283397, 0.0672726482, 0.226737246}},
+    {"biomeValue.x", SIN_HASH_NOISE, 5.80991662e-05, {0.000839772518, 3.74390365e-05, -1.63955829e-05, -0.000449785381}},
+    {"biomeValue.y", SIN_HASH_NOISE, -0.00107552192, {-0.072547771, -0.0252631381, 0.0229694694, 0.0708175227}},
+    {"desertValue", SIN_HASH_NOISE, 133.742502, {133.537674, 133.571152, 133.532379, 133.678757}},
+    {"mountainValue", SIN_HASH_NOISE, 232.543344, {222.650574, 236.555542, 240.307968, 221.753479}},
+    {"grasslandValue", SIN_HASH_NOISE, 130.377068, {130.514862, 130.752258, 130.176361, 130.47998}},
+    {"islandValue", SIN_HASH_NOISE, 118.945618, {126.003273, 129.546509, 111.381935, 130.851608}},
+    {"perlinNoise(vec2)", INTEGER_HASH_NOISE, -0.000527726366, {0, 0.150394261, -0.0247551687, -0.0907784179}},
+    {"perlinNoise(vec3)", INTEGER_HASH_NOISE, 0.0026494388, {0, 0.0044362545, 0.119724497, -0.191493824}},
+    {"fbm", INTEGER_HASH_NOISE, 0.510177118, {0.300159574, 0.516344726, 0.506582201, 0.238674045}},
+    {"fractalPerlin", INTEGER_HASH_NOISE, 0.912317064, {0.972262144, 0.867432296, 0.878927827, 0.941253304}},
+    {"mountainSummedPerlin", INTEGER_HASH_NOISE, 0.85960216, {0.847156823, 0.815065801, 0.81922549, 0.797531784}},
+    {"worleyNoise2Point", INTEGER_HASH_NOISE, 0.225569898, {0.376243293, 0.0630605817, 0.0576678142, 0.0700656101}},
+    {"biomeValue.x", INTEGER_HASH_NOISE, -0.000707571323, {-0.0477195159, -0.0167690162, 0.0152629055, 0.0465827659}},
+    {"biomeValue.y", INTEGER_HASH_NOISE, -0.000700530846, {-0.0477323383, -0.0167225953, 0.0152077843, 0.0466645472}},
+    {"desertValue", INTEGER_HASH_NOISE, 133.787345, {133.39241, 133.822708, 133.80777, 133.511093}},
+    {"mountainValue", INTEGER_HASH_NOISE, 217.329745, {213.838211, 206.854828, 207.729752, 203.263947}},
+    {"grasslandValue", INTEGER_HASH_NOISE, 130.923682, {133.706345, 128.597748, 128.844208, 130.180466}},
+    {"islandValue", INTEGER_HASH_NOISE, 111.534434, {109.15889, 105.175491, 108.765106, 103.738029}},
+};
@@ -0,0 +1,313 @@
+#include "scene/noise_functions.h"
+#include "golden.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Times each noise primitive, single-point and batched, on a fixed
+// grid of inputs and reports nanoseconds per sample and throughput.
+// Every primitive is also checked against golden values recorded
+// from the reference implementation (see golden.h), and every batch
+// function against its single-point function, so that a faster
+// variant can be verified to still generate the same world. The
+// desert's batch heights are also checked next to its terraces.
+// Exits with 1 if any check fails.
+//
+// Usage: noisemicrobench [--print-golden]
+// --print-golden prints a new golden.h for the current implementation.
+
+using Clock = std::chrono::steady_clock;
+
+// Each primitive is evaluated over the whole grid, repeatedly,
+// until it has run for at least this many seconds
+#define MIN_TIMING_SECONDS 0.05
+
+// Where a primitive's input comes from: the world-space column p,
+// or the chunk-local block (p.x, y, p.y) for the 3D noise
+struct Sample {
+    vec2 p;
+    int y;
+};
+
+struct Primitive {
+    const char *name;
+    std::function<float(const Sample&)> single;
+    // Evaluates NOISE_BATCH_SIZE samples at once. Null for
+    // primitives that have no batch version.
+    std::function<void(const Sample*, float*)> batch;
+    // How far the batch version may stray from the single-point one
+    float batchTolerance;
+};
+
+// Inputs scaled the way the terrain generator scales them
+static std::vector<Primitive> primitives() {
+    auto batchOf = [](std::function<vec2(vec2)> scale, std::function<void(const vec2*, float*)> f) {
+        return [scale, f](const Sample *samples, float *out) {
+            vec2 uv[NOISE_BATCH_SIZE];
+            for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                uv[i] = scale(samples[i].p);
+            }
+            f(uv, out);
+        };
+    };
+    // A few lattice cells across the grid, for the bare 2D noise
+    auto lattice = [](vec2 p) { return p / 16.f; };
+    auto biome = [](vec2 p) { return p / 750.f; };
+    auto identity = [](vec2 p) { return p; };
+    auto worley = [](vec2 p) { return p / 64.f; };
+    auto fractal = [](vec2 p) { return p / 256.f; };
+    auto summed = [](vec2 p) { return p / 128.f; };
+
+    return {
+        {"perlinNoise(vec2)",
+         [=](const Sample &s) { return perlinNoise(lattice(s.p)); },
+         batchOf(lattice, perlinNoiseBatch), NOISE_BATCH_TOLERANCE},
+        {"perlinNoise(vec3)",
+         [](const Sample &s) { return perlinNoise(vec3(s.p.x, s.y, s.p.y) / 8.f); },
+         nullptr, 0.f},
+        {"fbm",
+         [=](const Sample &s) { return fbm(summed(s.p), 4); },
+         batchOf(summed, [](const vec2 *uv, float *out) { fbmBatch(uv, 4, out); }), NOISE_BATCH_TOLERANCE},
+        {"fractalPerlin",
+         [=](const Sample &s) { return fractalPerlin(fractal(s.p), 8); },
+         batchOf(fractal, [](const vec2 *uv, float *out) { fractalPerlinBatch(uv, 8, out); }), NOISE_BATCH_TOLERANCE},
+        {"mountainSummedPerlin",
+         [=](const Sample &s) { return mountainSummedPerlin(summed(s.p), 6); },
+         batchOf(summed, [](const vec2 *uv, float *out) { mountainSummedPerlinBatch(uv, 6, out); }),
+         NOISE_BATCH_TOLERANCE},
+        {"worleyNoise2Point",
+         [=](const Sample &s) {
+             float cellHeight = 1.f;
+             float w = worleyNoise2Point(worley(s.p), &cellHeight);
+             return w * cellHeight;
+         },
+         batchOf(worley, [](const vec2 *uv, float *out) {
+             float cellHeights[NOISE_BATCH_SIZE];
+             std::fill(cellHeights, cellHeights + NOISE_BATCH_SIZE, 1.f);
+             worleyNoise2PointBatch(uv, out, cellHeights);
+             for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                 out[i] *= cellHeights[i];
+             }
+         }), NOISE_BATCH_TOLERANCE},
+        {"biomeValue.x",
+         [=](const Sample &s) { return biomeValue(biome(s.p)).x; },
+         batchOf(biome, [](const vec2 *uv, float *out) {
+             vec2 values[NOISE_BATCH_SIZE];
+             biomeValueBatch(uv, values);
+             for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                 out[i] = values[i].x;
+             }
+         }), NOISE_BATCH_TOLERANCE},
+        {"biomeValue.y",
+         [=](const Sample &s) { return biomeValue(biome(s.p)).y; },
+         batchOf(biome, [](const vec2 *uv, float *out) {
+             vec2 values[NOISE_BATCH_SIZE];
+             biomeValueBatch(uv, values);
+             for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                 out[i] = values[i].y;
+             }
+         }), NOISE_BATCH_TOLERANCE},
+        {"desertValue",
+         [](const Sample &s) { return desertValue(s.p); },
+         batchOf(identity, desertValueBatch), NOISE_BATCH_HEIGHT_TOLERANCE},
+        {"mountainValue",
+         [](const Sample &s) { return mountainValue(s.p); },
+         batchOf(identity, mountainValueBatch), NOISE_BATCH_HEIGHT_TOLERANCE},
+        {"grasslandValue",
+         [](const Sample &s) { return grasslandValue(s.p); },
+         batchOf(identity, grasslandValueBatch), NOISE_BATCH_HEIGHT_TOLERANCE},
+        {"islandValue",
+         [](const Sample &s) { return islandValue(s.p); },
+         batchOf(identity, islandValueBatch), NOISE_BATCH_HEIGHT_TOLERANCE},
+    };
+}
+
+// The grid every primitive is evaluated on, one row of
+// GOLDEN_GRID_SIZE samples after another. The 3D noise
+// climbs through a Chunk's heights as the rows go by.
+static std::vector<Sample> grid() {
+    std::vector<Sample> samples;
+    for (int z = 0; z < GOLDEN_GRID_SIZE; ++z) {
+        for (int x = 0; x < GOLDEN_GRID_SIZE; ++x) {
+            samples.push_back({vec2(GOLDEN_GRID_ORIGIN + x, GOLDEN_GRID_ORIGIN + z), (4 * z) % 256});
+        }
+    }
+    return samples;
+}
+
+// Side of the square of columns searched for desert terrace edges
+#define TERRACE_SEARCH_SIZE 1024
+
+// desertValue() steps by up to ~5 blocks at its terraces, and none of
+// the grid's columns land near a step, so checking desertValueBatch()
+// on the grid alone would miss a batch that puts columns on the wrong
+// side of one. Checks it at every column of a TERRACE_SEARCH_SIZE
+// square whose batch noise lies within twice NOISE_BATCH_TOLERANCE of
+// a step. Returns the largest difference from desertValue(), and
+// the number of such columns in count.
+static float checkDesertTerraceEdges(int *count) {
+    *count = 0;
+    float worst = 0.f;
+    for (int z = 0; z < TERRACE_SEARCH_SIZE; ++z) {
+        for (int x = 0; x < TERRACE_SEARCH_SIZE; x += NOISE_BATCH_SIZE) {
+            vec2 uv[NOISE_BATCH_SIZE];
+            float noise[NOISE_BATCH_SIZE], heights[NOISE_BATCH_SIZE];
+            for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                uv[i] = vec2(GOLDEN_GRID_ORIGIN + x + i, GOLDEN_GRID_ORIGIN + z);
+            }
+            desertNoiseBatch(uv, noise);
+            bool nearStep = false;
+            for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                float scaled = 100.f * noise[i];
+                nearStep = nearStep ||
+                        (noise[i] >= DESERT_TERRACE_MIN - 0.01f && noise[i] <= DESERT_TERRACE_MAX + 0.01f &&
+                         glm::abs(scaled - glm::round(scaled)) <= 200.f * NOISE_BATCH_TOLERANCE);
+            }
+            if (!nearStep) {
+                continue;
+            }
+            desertValueBatch(uv, heights);
+            for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                float scaled = 100.f * noise[i];
+                if (glm::abs(scaled - glm::round(scaled)) <= 200.f * NOISE_BATCH_TOLERANCE) {
+                    worst = glm::max(worst, glm::abs(heights[i] - desertValue(uv[i])));
+                    (*count)++;
+                }
+            }
+        }
+    }
+    return worst;
+}
+
+// Runs evaluate() until MIN_TIMING_SECONDS have passed,
+// and returns the nanoseconds it took per sample
+static double timePerSample(const std::function<void()> &evaluate, size_t samples) {
+    int reps = 0;
+    Clock::time_point start = Clock::now();
+    double seconds = 0.0;
+    do {
+        evaluate();
+        reps++;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (seconds < MIN_TIMING_SECONDS);
+    return seconds * 1e9 / (double(reps) * samples);
+}
+
+static bool close(double a, double b) {
+    return glm::abs(a - b) <= GOLDEN_TOLERANCE * glm::max(1.0, glm::abs(b));
+}
+
+static const NoiseGolden* findGolden(const char *name, NoiseBackend backend) {
+    for (const NoiseGolden &g : s_noiseGoldens) {
+        if (std::strcmp(g.name, name) == 0 && g.backend == backend) {
+            return &g;
+        }
+    }
+    return nullptr;
+}
+
+int main(int argc, char **argv) {
+    bool printGolden = argc > 1 && std::strcmp(argv[1], "--print-golden") == 0;
+    if (argc > 1 && !printGolden) {
+        std::fprintf(stderr, "usage: %s [--print-golden]\n", argv[0]);
+        return 1;
+    }
+
+    const struct {
+        const char *name;
+        const char *enumName;
+        WorldNoise noise;
+    } backends[] = {
+        {"sin hash", "SIN_HASH_NOISE", WorldNoise(SIN_HASH_NOISE)},
+        {"integer hash", "INTEGER_HASH_NOISE", WorldNoise(INTEGER_HASH_NOISE, GOLDEN_SEED)},
+    };
+    std::vector<Sample> samples = grid();
+    size_t n = samples.size();
+    int failures = 0;
+
+    if (!printGolden) {
+        std::printf("%d x %d grid, integer hash seed %#llx\n", GOLDEN_GRID_SIZE, GOLDEN_GRID_SIZE,
+                    static_cast<unsigned long long>(GOLDEN_SEED));
+        std::printf("%-14s %-22s %-7s %12s %14s %s\n", "backend", "primitive", "mode", "ns/sample",
+                    "Msamples/s", "check");
+    }
+    for (const auto &backend : backends) {
+        WorldNoiseScope scope(backend.noise);
+        for (const Primitive &prim : primitives()) {
+            std::vector<float> single(n), batch(n);
+            double singleNs = timePerSample([&]() {
+                for (size_t i = 0; i < n; ++i) {
+                    single[i] = prim.single(samples[i]);
+                }
+            }, n);
+
+            double mean = 0.0;
+            for (float v : single) {
+                mean += v;
+            }
+            mean /= n;
+            const size_t picks[4] = {0, n / 3, 2 * n / 3, n - 1};
+
+            if (printGolden) {
+                std::printf("    {\"%s\", %s, %.9g, {%.9g, %.9g, %.9g, %.9g}},\n", prim.name, backend.enumName,
+                            mean, single[picks[0]], single[picks[1]], single[picks[2]], single[picks[3]]);
+                continue;
+            }
+
+            // Golden values
+            std::string check = "ok";
+            const NoiseGolden *golden = findGolden(prim.name, backend.noise.backend);
+            if (golden == nullptr) {
+                check = "NO GOLDEN";
+            }
+            else {
+                bool ok = close(mean, golden->mean);
+                for (int i = 0; i < 4; ++i) {
+                    ok = ok && close(single[picks[i]], golden->samples[i]);
+                }
+                if (!ok) {
+                    check = "GOLDEN MISMATCH";
+                }
+            }
+            failures += check != "ok";
+            std::printf("%-14s %-22s %-7s %12.1f %14.2f %s\n", backend.name, prim.name, "single",
+                        singleNs, 1e3 / singleNs, check.c_str());
+
+            if (!prim.batch) {
+                continue;
+            }
+            double batchNs = timePerSample([&]() {
+                for (size_t i = 0; i < n; i += NOISE_BATCH_SIZE) {
+                    prim.batch(&samples[i], &batch[i]);
+                }
+            }, n);
+            // Batches must match the single-point function they replace
+            float worst = 0.f;
+            for (size_t i = 0; i < n; ++i) {
+                worst = glm::max(worst, glm::abs(batch[i] - single[i]));
+            }
+            check = worst <= prim.batchTolerance ? "ok" : "BATCH MISMATCH";
+            failures += check != "ok";
+            std::printf("%-14s %-22s %-7s %12.1f %14.2f %s (max diff %.2g)\n", backend.name, prim.name, "batch",
+                        batchNs, 1e3 / batchNs, check.c_str(), worst);
+        }
+
+        if (!printGolden) {
+            int edges = 0;
+            float worst = checkDesertTerraceEdges(&edges);
+            std::string check = worst <= NOISE_BATCH_HEIGHT_TOLERANCE ? "ok" : "BATCH MISMATCH";
+            failures += check != "ok";
+            std::printf("%-14s %-22s %-7s %12s %14s %s (%d columns, max diff %.2g)\n", backend.name,
+                        "desertValue terraces", "batch", "", "", check.c_str(), edges, worst);
+        }
+    }
+
+    if (!printGolden) {
+        std::printf("%d check(s) failed\n", failures);
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,18 @@
+# Headless microbenchmark of the individual noise primitives, with
+# golden-value checks. Build and run it from a shadow build directory:
+#   qmake path/to/noisemicrobench.pro && make && ./noisemicrobench
+
+TARGET = noisemicrobench
+TEMPLATE = app
+CONFIG += console c++1z release
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../../include ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/scene/noise_functions.cpp
+
+HEADERS += \
+    golden.h \
+    ../../src/scene/noise_functions.h
@@ -0,0 +1,311 @@
+#include "scene/chunkworkers.h"
+#include "scene/zonefieldcache.h"
+#include "scene/terrainjobs.h"
+#include "scene/terrain.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Generates terrain zones with FBMWorkers and then meshes every one of
+// their Chunks with VBOWorkers, both on a TerrainJobScheduler, exactly
+// as Terrain does but without a window or GL context. Reports the
+// throughput of each stage, the size of the meshes, the peak memory
+// used, and the latency of individual jobs: how long each waited in
+// the scheduler's queue plus how long it took to run.
+//
+// Usage: terrainbench [--zones N] [--origin X Z] [--seed S]
+//                     [--threads T] [--greedy] [--coarse-heights]
+//                     [--coarse-materials] [--revisit]
+// Without --seed the world uses the sin hash noise backend (the
+// game's default), with it the integer hash backend and that seed.
+// --coarse-heights and --coarse-materials generate with
+// COARSE_HEIGHT_SAMPLING and COARSE_MATERIAL_SAMPLING, and --greedy
+// meshes with GREEDY_MESHING.
+// --revisit instead drives a whole Terrain, as MyGL::tick() does,
+// out of the zone at the origin and back, and exits with 1 if the
+// zone isn't meshed again once the player returns.
+
+using Clock = std::chrono::steady_clock;
+
+// The run times and latencies (queue wait plus run time), in
+// milliseconds, of every job of one stage
+struct JobTimes {
+    vector<double> m_runMillis, m_latencyMillis;
+    QMutex m_lock;
+};
+
+// Runs another job and records how long it took, and how long it
+// had waited since it was made, which is when it is submitted
+class TimedJob : public QRunnable {
+private:
+    QRunnable *mp_job;
+    JobTimes *mp_times;
+    Clock::time_point m_submitted;
+
+public:
+    TimedJob(QRunnable *job, JobTimes *times)
+        : mp_job(job), mp_times(times), m_submitted(Clock::now())
+    {}
+
+    void run() override {
+        Clock::time_point start = Clock::now();
+        mp_job->run();
+        Clock::time_point end = Clock::now();
+        if (mp_job->autoDelete()) {
+            delete mp_job;
+        }
+        QMutexLocker locker(&mp_times->m_lock);
+        mp_times->m_runMillis.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        mp_times->m_latencyMillis.push_back(std::chrono::duration<double, std::milli>(end - m_submitted).count());
+    }
+};
+
+static double percentile(vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t i = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + i, values.end());
+    return values[i];
+}
+
+// Peak resident set size of this process, in MB
+static double peakRSSMegabytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+#else
+    return 0.0;
+#endif
+}
+
+// Sleeps until count() reaches target
+template<typename Count>
+static void waitFor(Count count, size_t target) {
+    while (count() < target) {
+        QThread::msleep(1);
+    }
+}
+
+// How long the --revisit scenario waits for each step
+#define REVISIT_TIMEOUT_SECONDS 60.0
+
+// Whether every Chunk of the zone with corner (x, z) has a mesh
+static bool zoneMeshed(Terrain &terrain, int x, int z) {
+    for (int cx = x; cx < x + 64; cx += 16) {
+        for (int cz = z; cz < z + 64; cz += 16) {
+            glm::vec3 min, max;
+            if (!terrain.hasChunkAt(cx, cz) || !terrain.getChunkAt(cx, cz)->meshBounds(&min, &max)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Ticks terrain as MyGL::tick() does, with the player having just
+// moved from prev to pos, until done() or the timeout. Returns done().
+template<typename Done>
+static bool tickUntil(Terrain &terrain, glm::vec3 pos, glm::vec3 prev, Done done) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!done() && timer.nsecsElapsed() * 1e-9 < REVISIT_TIMEOUT_SECONDS) {
+        terrain.tryExpansion(pos, prev, glm::vec3(0.f, 0.f, 1.f));
+        terrain.checkThreadResults();
+        prev = pos;
+        QThread::msleep(1);
+    }
+    return done();
+}
+
+// Generates the world around the origin as MyGL does, walks far enough
+// away that the origin's zone leaves TERRAIN_CREATE_RADIUS, and comes
+// back. Returns whether the zone was meshed again.
+static bool revisitScenario(const WorldNoise &noise) {
+    OpenGLContext context(nullptr);
+    Terrain terrain(&context, noise);
+    terrain.generateTerrain(-64 * TERRAIN_CREATE_RADIUS, 64 * (TERRAIN_CREATE_RADIUS + 1),
+                            -64 * TERRAIN_CREATE_RADIUS, 64 * (TERRAIN_CREATE_RADIUS + 1));
+    glm::vec3 home(32.f, 164.f, 32.f);
+    glm::vec3 away = home + glm::vec3(64.f * (2 * TERRAIN_CREATE_RADIUS + 1), 0.f, 0.f);
+
+    bool meshed = tickUntil(terrain, home, home, [&]() { return zoneMeshed(terrain, 0, 0); });
+    std::printf("%-34s %s\n", "origin zone meshed", meshed ? "ok" : "FAILED");
+    bool left = tickUntil(terrain, away, home, [&]() {
+        return zoneMeshed(terrain, static_cast<int>(away.x) / 64 * 64, 0);
+    });
+    left = left && !zoneMeshed(terrain, 0, 0);
+    std::printf("%-34s %s\n", "origin zone destroyed when away", left ? "ok" : "FAILED");
+    bool remeshed = tickUntil(terrain, home, away, [&]() { return zoneMeshed(terrain, 0, 0); });
+    std::printf("%-34s %s\n", "origin zone meshed on return", remeshed ? "ok" : "FAILED");
+    return meshed && left && remeshed;
+}
+
+int main(int argc, char **argv) {
+    int zoneCount = 25;
+    int originX = 0, originZ = 0;
+    WorldNoise noise;
+    int threads = TerrainJobScheduler::defaultThreadCount();
+    bool revisit = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--zones" && i + 1 < argc) {
+            zoneCount = std::atoi(argv[++i]);
+        }
+        else if (arg == "--origin" && i + 2 < argc) {
+            originX = std::atoi(argv[++i]);
+            originZ = std::atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            noise = WorldNoise(INTEGER_HASH_NOISE, std::strtoull(argv[++i], nullptr, 0));
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        }
+        else if (arg == "--greedy") {
+            VBOWorker::setMeshingMode(GREEDY_MESHING);
+        }
+        else if (arg == "--coarse-heights") {
+            FBMWorker::setHeightSamplingMode(COARSE_HEIGHT_SAMPLING);
+        }
+        else if (arg == "--coarse-materials") {
+            FBMWorker::setMaterialSamplingMode(COARSE_MATERIAL_SAMPLING);
+        }
+        else if (arg == "--revisit") {
+            revisit = true;
+        }
+        else {
+            zoneCount = 0;
+            break;
+        }
+    }
+    if (zoneCount < 1 || threads < 1) {
+        std::fprintf(stderr, "usage: %s [--zones N] [--origin X Z] [--seed S] [--threads T] [--greedy] [--coarse-heights] [--coarse-materials] [--revisit]\n",
+                     argv[0]);
+        return 1;
+    }
+    if (revisit) {
+        return revisitScenario(noise) ? 0 : 1;
+    }
+
+    // The zoneCount zones whose centers are closest to the origin
+    int originZoneX = static_cast<int>(64.f * glm::floor(originX / 64.f));
+    int originZoneZ = static_cast<int>(64.f * glm::floor(originZ / 64.f));
+    int radius = static_cast<int>(glm::ceil(glm::sqrt(float(zoneCount)))) + 1;
+    vector<pair<float, ivec2>> candidates;
+    for (int i = -radius; i <= radius; ++i) {
+        for (int j = -radius; j <= radius; ++j) {
+            ivec2 corner(originZoneX + 64 * i, originZoneZ + 64 * j);
+            float dist = glm::length(vec2(corner) + vec2(32.f) - vec2(originX, originZ));
+            candidates.push_back({dist, corner});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const pair<float, ivec2> &a, const pair<float, ivec2> &b) {
+        return a.first < b.first;
+    });
+    candidates.resize(zoneCount);
+
+    // Every Chunk of those zones, linked to its neighbors as Terrain would
+    unordered_map<int64_t, uPtr<Chunk>> chunks;
+    for (const auto &zone : candidates) {
+        for (int x = zone.second.x; x < zone.second.x + 64; x += 16) {
+            for (int z = zone.second.y; z < zone.second.y + 64; z += 16) {
+                chunks[toKey(x, z)] = mkU<Chunk>(nullptr, x, z);
+            }
+        }
+    }
+    for (auto &kvp : chunks) {
+        ivec2 coords = toCoords(kvp.first);
+        auto north = chunks.find(toKey(coords.x, coords.y + 16));
+        if (north != chunks.end()) {
+            kvp.second->linkNeighbor(north->second, ZPOS);
+        }
+        auto east = chunks.find(toKey(coords.x + 16, coords.y));
+        if (east != chunks.end()) {
+            kvp.second->linkNeighbor(east->second, XPOS);
+        }
+    }
+
+    const char *backend = noise.backend == SIN_HASH_NOISE ? "sin hash" : "integer hash";
+    std::printf("%d zones (%zu chunks) around (%d, %d), %s noise, seed %llu, %d threads, %s meshing, %s heights, %s materials\n",
+                zoneCount, chunks.size(), originX, originZ, backend, static_cast<unsigned long long>(noise.seed),
+                threads, VBOWorker::getMeshingMode() == GREEDY_MESHING ? "greedy" : "per-face",
+                FBMWorker::getHeightSamplingMode() == FULL_HEIGHT_SAMPLING ? "full" : "coarse",
+                FBMWorker::getMaterialSamplingMode() == FULL_MATERIAL_SAMPLING ? "full" : "coarse");
+
+    TerrainJobScheduler jobs(threads);
+    jobs.setFocus(glm::vec3(originX, 0.f, originZ), glm::vec3(0.f));
+    sPtr<TerrainJobToken> token = mkS<TerrainJobToken>();
+    ZoneFieldCache fieldCache(noise);
+
+    // Generate every zone, one Chunk per job
+    std::unordered_set<Chunk*> generated;
+    QMutex generatedLock;
+    JobTimes generateTimes;
+    QElapsedTimer timer;
+    timer.start();
+    for (const auto &zone : candidates) {
+        for (int x = zone.second.x; x < zone.second.x + 64; x += 16) {
+            for (int z = zone.second.y; z < zone.second.y + 64; z += 16) {
+                FBMWorker *worker = new FBMWorker(chunks[toKey(x, z)].get(), noise, &fieldCache,
+                                                  &generated, &generatedLock);
+                jobs.submit(GENERATE_JOB, vec2(x + 8, z + 8), token, new TimedJob(worker, &generateTimes));
+            }
+        }
+    }
+    waitFor([&]() {
+        QMutexLocker locker(&generatedLock);
+        return generated.size();
+    }, chunks.size());
+    double generateSeconds = timer.nsecsElapsed() * 1e-9;
+
+    // Then mesh every Chunk
+    vector<ChunkVBOData> meshed;
+    QMutex meshedLock;
+    JobTimes meshTimes;
+    timer.start();
+    for (auto &kvp : chunks) {
+        Chunk *c = kvp.second.get();
+        ivec2 coords = toCoords(kvp.first);
+        VBOWorker *worker = new VBOWorker(c, token, &meshed, &meshedLock);
+        jobs.submit(MESH_JOB, vec2(coords) + vec2(8.f), token, new TimedJob(worker, &meshTimes));
+    }
+    waitFor([&]() {
+        QMutexLocker locker(&meshedLock);
+        return meshed.size();
+    }, chunks.size());
+    double meshSeconds = timer.nsecsElapsed() * 1e-9;
+    jobs.stop();
+
+    size_t vertices = 0;
+    for (const ChunkVBOData &d : meshed) {
+        vertices += (d.m_vboDataOpaque.size() + d.m_vboDataTransparent.size()) / CHUNK_VERTEX_WORDS;
+    }
+
+    std::printf("%-10s %12s %14s %14s %14s %14s %14s\n", "stage", "per second", "latency p50", "latency p99",
+                "run p50", "run p99", "total (s)");
+    auto printStage = [](const char *stage, double perSecond, const JobTimes &times, double seconds) {
+        std::printf("%-10s %12.2f %14.3f %14.3f %14.3f %14.3f %14.3f\n", stage, perSecond,
+                    percentile(times.m_latencyMillis, 0.5), percentile(times.m_latencyMillis, 0.99),
+                    percentile(times.m_runMillis, 0.5), percentile(times.m_runMillis, 0.99), seconds);
+    };
+    printStage("generate", zoneCount / generateSeconds, generateTimes, generateSeconds);
+    printStage("mesh", chunks.size() / meshSeconds, meshTimes, meshSeconds);
+    std::printf("generate is in zones, mesh in chunks, and every job is one chunk\n");
+    std::printf("job times are in ms; latency is from submission to the end of the run\n");
+    std::printf("vertices per chunk: %.1f\n", double(vertices) / chunks.size());
+    std::printf("peak RSS: %.1f MB\n", peakRSSMegabytes());
+    return 0;
+}
@@ -0,0 +1,53 @@
+# Headless benchmark of terrain generation and meshing.
+# Only needs QtCore. Chunk is a Drawable, so the scene code is built
+# against the stand-in GL headers and context in ../headless, which
+# never open a window or touch GL, so it runs without a display.
+# Build and run it from a shadow build directory:
+#   qmake path/to/terrainbench.pro && make && ./terrainbench
+
+TARGET = terrainbench
+TEMPLATE = app
+QT = core
+CONFIG += console c++1z release
+CONFIG -= app_bundle
+
+# ../headless must come first, to stand in for Qt's GL headers
+INCLUDEPATH += ../headless ../../include ../../src
+
+SOURCES += \
+    main.cpp \
+    ../headless/headlessgl.cpp \
+    ../../src/drawable.cpp \
+    ../../src/shaderprogram.cpp \
+    ../../src/scene/camera.cpp \
+    ../../src/scene/chunkmesharena.cpp \
+    ../../src/scene/chunksection.cpp \
+    ../../src/scene/chunkworkers.cpp \
+    ../../src/scene/entity.cpp \
+    ../../src/scene/frustum.cpp \
+    ../../src/scene/noise_functions.cpp \
+    ../../src/scene/quadindexbuffer.cpp \
+    ../../src/scene/terrain.cpp \
+    ../../src/scene/terrainjobs.cpp \
+    ../../src/scene/zonefieldcache.cpp
+
+HEADERS += \
+    ../headless/QOpenGLFunctions_3_2_Core \
+    ../headless/QOpenGLWidget \
+    ../../src/drawable.h \
+    ../../src/openglcontext.h \
+    ../../src/shaderprogram.h \
+    ../../src/texture.h \
+    ../../src/scene/camera.h \
+    ../../src/scene/chunk.h \
+    ../../src/scene/chunkmesharena.h \
+    ../../src/scene/chunkhelpers.h \
+    ../../src/scene/chunksection.h \
+    ../../src/scene/chunkworkers.h \
+    ../../src/scene/entity.h \
+    ../../src/scene/frustum.h \
+    ../../src/scene/noise_functions.h \
+    ../../src/scene/quadindexbuffer.h \
+    ../../src/scene/terrain.h \
+    ../../src/scene/terrainjobs.h \
+    ../../src/scene/zonefieldcache.h
@@ -23,9 +23,8 @@ uniform float u_Time;
 in vec4 fs_Pos;
 in vec4 fs_Nor;
 in vec4 fs_LightVec;
-in vec2 fs_UV;
-in float fs_CosPow;
-in float fs_Anim;
+flat in vec2 fs_UV;
+in vec2 fs_BlockUV;
 
 out vec4 out_Col; // This is the final output color that you will see on your
 // screen for the pixel that is currently being processed.
@@ -142,7 +141,8 @@ void main()
     vec3 toPlayer = fs_Pos.xyz - u_PlayerPos;
 
     // Material base color (before shading)
-    vec4 diffuseColor = texture(u_TerrainTexture, fs_UV);
+    // Each texture tile is 1/16th of the texture wide
+    vec4 diffuseColor = texture(u_TerrainTexture, fs_UV + fract(fs_BlockUV) / 16.f);
 
     vec3 shadingNormal = normalize(fs_Nor.xyz);
 
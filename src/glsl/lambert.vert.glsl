@@ -24,39 +24,80 @@ uniform vec4 u_Color;       // When drawing the cube instance, we'll set our uni
 
 uniform vec3 u_PlayerPos;
 uniform float u_Time;
+uniform ivec2 u_ChunkOrigin; // The x / 16 and z / 16 of the Chunk the camera is in.
+                             // Every Chunk is positioned relative to it.
 
-in vec4 vs_Pos;             // The array of vertex positions passed to the shader
-in vec4 vs_Nor;             // The array of vertex normals passed to the shader
-in vec2 vs_UV;
-in float vs_CosPow;
-in float vs_Anim;
+in uvec2 vs_Packed;         // One packed Chunk vertex. See chunkhelpers.h for its layout:
+                            // x.bits 0-4, 5-13, 14-18 are the position and 19-21 the face Direction,
+                            // y.bits 0-7 are the texture tile (column + 16 * row),
+                            // 8-19 and 20-31 the Chunk's x / 16 and z / 16, modulo 4096
 
 out vec4 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
 out vec4 fs_LightVec;       // The direction in which our virtual light lies, relative to each vertex. This is implicitly passed to the fragment shader.
-out vec2 fs_UV;            // The color of each vertex. This is implicitly passed to the fragment shader.
-out float fs_CosPow;
-out float fs_Anim;
+flat out vec2 fs_UV;        // The origin of the face's texture tile. Not interpolated, so the
+                            // fragment shader can compare it against exact tile boundaries.
+out vec2 fs_BlockUV;        // Where the vertex lies across its face, in blocks.
+                            // A face merged across several blocks repeats its tile once per block.
 
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
 
+// Face normals, indexed by Direction (XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG)
+const vec3 faceNormals[6] = vec3[6](vec3(1, 0, 0), vec3(-1, 0, 0),
+                                    vec3(0, 1, 0), vec3(0, -1, 0),
+                                    vec3(0, 0, 1), vec3(0, 0, -1));
+
 void main()
 {
-    fs_Pos = u_Model * vs_Pos;
-    fs_UV = vs_UV;                         // Pass the vertex colors to the fragment shader for interpolation
-    fs_CosPow = vs_CosPow;
-    fs_Anim = vs_Anim;
+    // Unpack the vertex
+    vec4 pos = vec4(float(vs_Packed.x & 31u),
+                    float((vs_Packed.x >> 5u) & 511u),
+                    float((vs_Packed.x >> 14u) & 31u), 1);
+    int face = int((vs_Packed.x >> 19u) & 7u);
+    vec4 nor = vec4(faceNormals[face], 0);
+    uint tile = vs_Packed.y & 255u;
+    // Place the vertex in its Chunk, whose stored coordinates wrap
+    // around every 4096 Chunks, by how far it is from the camera's
+    ivec2 chunk = ivec2(int((vs_Packed.y >> 8u) & 4095u), int(vs_Packed.y >> 20u));
+    ivec2 chunkOffset = ((chunk - (u_ChunkOrigin & 4095) + 2048) & 4095) - 2048;
+    ivec2 chunkCorner = 16 * (u_ChunkOrigin + chunkOffset);
+    vec4 worldPos = pos + vec4(chunkCorner.x, 0, chunkCorner.y, 0);
+
+    fs_Pos = u_Model * worldPos;
+    fs_UV = vec2(float(tile & 15u), float(tile >> 4u)) / 16.f;
+
+    // Project the position onto the face's plane, oriented to
+    // match the corner UVs of adjacentFaces in chunkhelpers.h
+    vec3 p = pos.xyz;
+    if (face == 0) {
+        fs_BlockUV = vec2(-p.z, p.y);
+    }
+    else if (face == 1) {
+        fs_BlockUV = vec2(p.z, p.y);
+    }
+    else if (face == 2) {
+        fs_BlockUV = vec2(p.x, -p.z);
+    }
+    else if (face == 3) {
+        fs_BlockUV = vec2(p.x, p.z);
+    }
+    else if (face == 4) {
+        fs_BlockUV = vec2(p.x, p.y);
+    }
+    else {
+        fs_BlockUV = vec2(-p.x, p.y);
+    }
 
     mat3 invTranspose = mat3(u_ModelInvTr);
-    fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
+    fs_Nor = vec4(invTranspose * vec3(nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
                                                             // Transform the geometry's normals by the inverse transpose of the
                                                             // model matrix. This is necessary to ensure the normals remain
                                                             // perpendicular to the surface after the surface is transformed by
                                                             // the model matrix.
 
 
-    vec4 modelposition = u_Model * vs_Pos;   // Temporarily store the transformed vertex positions for use below
+    vec4 modelposition = u_Model * worldPos;   // Temporarily store the transformed vertex positions for use below
 
 
     // Displace water vertically
@@ -16,9 +16,12 @@ Drawable::~Drawable()
 void Drawable::destroy()
 {
     mp_context->glDeleteBuffers(1, &m_bufIdxOpq);
+    mp_context->glDeleteBuffers(1, &m_bufIdxTra);
+    mp_context->forgetArrayBuffer(m_bufOpq);
+    mp_context->forgetArrayBuffer(m_bufTra);
     mp_context->glDeleteBuffers(1, &m_bufOpq);
     mp_context->glDeleteBuffers(1, &m_bufTra);
-    m_bufIdxOpq = m_bufOpq = m_bufTra = 0; // Prevent double-deletion
+    m_bufIdxOpq = m_bufIdxTra = m_bufOpq = m_bufTra = 0; // Prevent double-deletion
     m_idxOpqGenerated = m_idxTraGenerated = m_opqGenerated = m_traGenerated = false;
     m_count = 0;
     m_hasBeenDestroyed = true;
@@ -39,11 +42,16 @@ GLenum Drawable::drawMode()
     return GL_TRIANGLES;
 }
 
-int Drawable::elemCount() const
+int Drawable::elemCount(bool) const
 {
     return m_count;
 }
 
+GLenum Drawable::idxType(bool) const
+{
+    return GL_UNSIGNED_INT;
+}
+
 void Drawable::generateIdxOpq()
 {
     m_idxOpqGenerated = true;
@@ -73,8 +81,14 @@ void Drawable::generateTra()
     mp_context->glGenBuffers(1, &m_bufTra);
 }
 
-bool Drawable::bindIdx()
+bool Drawable::bindIdx(bool opaque)
 {
+    if (!opaque) {
+        if (m_idxTraGenerated) {
+            mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxTra);
+        }
+        return m_idxTraGenerated;
+    }
     if (m_idxOpqGenerated) {
         mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpq);
     }
@@ -84,7 +98,7 @@ bool Drawable::bindIdx()
 bool Drawable::bindOpq()
 {
     if (m_opqGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpq);
+        mp_context->bindArrayBuffer(m_bufOpq);
     }
     return m_opqGenerated;
 }
@@ -92,7 +106,7 @@ bool Drawable::bindOpq()
 bool Drawable::bindTra()
 {
     if (m_traGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufTra);
+        mp_context->bindArrayBuffer(m_bufTra);
     }
     return m_traGenerated;
 }
@@ -12,6 +12,13 @@ struct vertexAttribute {
     float animFlag; // animation flag
 };
 
+// Chunks store each vertex as this many packed 32-bit words
+// instead of a vertexAttribute. See chunkhelpers.h for the layout.
+#define CHUNK_VERTEX_WORDS 2
+// The attribute location every ShaderProgram binds vs_Packed to, so
+// ChunkMeshArena's VAOs work with any shader that reads packed vertices
+#define CHUNK_PACKED_ATTRIB_LOCATION 0
+
 
 //This defines a class which can be rendered by our shader program.
 //Make any geometry a subclass of ShaderProgram::Drawable in order to render it with the ShaderProgram class.
@@ -39,12 +46,15 @@ public:
     virtual ~Drawable();
 
     virtual void create() = 0; // To be implemented by subclasses. Populates the VBOs of the Drawable.
-    void destroy(); // Frees the VBOs of the Drawable.
+    virtual void destroy(); // Frees the VBOs of the Drawable.
     bool hasBeenDestroyed() const;
 
     // Getter functions for various GL data
     virtual GLenum drawMode();
-    int elemCount() const;
+    // The number of indices to draw along with the opaque
+    // (or transparent) VBO, and their type
+    virtual int elemCount(bool opaque = true) const;
+    virtual GLenum idxType(bool opaque = true) const;
 
     // Call these functions when you want to call glGenBuffers on the buffers stored in the Drawable
     // These will properly set the values of idxBound etc. which need to be checked in ShaderProgram::draw()
@@ -53,7 +63,11 @@ public:
     void generateOpq();
     void generateTra();
 
-    bool bindIdx();
+    // Binds the index buffer to draw the opaque (or transparent) VBO with.
+    // By default this is m_bufIdxOpq (or m_bufIdxTra), but subclasses
+    // may draw from an index buffer they share instead, in which case
+    // they need not generate either of their own.
+    virtual bool bindIdx(bool opaque = true);
     bool bindOpq();
     bool bindTra();
 };
@@ -54,6 +54,8 @@ void FrameBuffer::create() {
         std::cout << "Frame buffer did not initialize correctly..." << std::endl;
         mp_context->printGLErrorLog();
     }
+    // We bound our texture without going through the state cache
+    mp_context->invalidateGLState();
 }
 
 void FrameBuffer::destroy() {
@@ -62,6 +64,8 @@ void FrameBuffer::destroy() {
         mp_context->glDeleteFramebuffers(1, &m_frameBuffer);
         mp_context->glDeleteTextures(1, &m_outputTexture);
         mp_context->glDeleteRenderbuffers(1, &m_depthRenderBuffer);
+        // Deleting our texture unbinds it
+        mp_context->invalidateGLState();
     }
 }
 
@@ -71,8 +75,7 @@ void FrameBuffer::bindFrameBuffer() {
 
 void FrameBuffer::bindToTextureSlot(unsigned int slot) {
     m_textureSlot = slot;
-    mp_context->glActiveTexture(GL_TEXTURE0 + slot);
-    mp_context->glBindTexture(GL_TEXTURE_2D, m_outputTexture);
+    mp_context->bindTexture2D(slot, m_outputTexture);
 }
 
 unsigned int FrameBuffer::getTextureSlot() const {
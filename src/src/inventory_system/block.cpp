@@ -26,7 +26,7 @@ void Block::create() {
 
     // send VBO data to the GPU
     generateOpq();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpq);
+    mp_context->bindArrayBuffer(m_bufOpq);
     mp_context->glBufferData(GL_ARRAY_BUFFER, vboData.size() * sizeof(vertexAttribute), vboData.data(), GL_STATIC_DRAW);
 }
 
@@ -20,6 +20,8 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->mygl, SIGNAL(sig_sendPlayerLook(QString)), &playerInfoWindow, SLOT(slot_setLookText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerChunk(QString)), &playerInfoWindow, SLOT(slot_setChunkText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerTerrainZone(QString)), &playerInfoWindow, SLOT(slot_setZoneText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendTerrainDrawStats(QString)), &playerInfoWindow, SLOT(slot_setDrawText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendGLStateStats(QString)), &playerInfoWindow, SLOT(slot_setGLStateText(QString)));
 }
 
 MainWindow::~MainWindow()
@@ -6,6 +6,12 @@
 #include <QKeyEvent>
 #include <QDateTime>
 
+// Where the player starts: over the middle of the origin's zone, at
+// least a couple of blocks clear of its terrain, even a tall mountain
+static glm::vec3 playerSpawn(const Terrain &terrain) {
+    float ground = glm::max(terrain.getSurfaceHeight(32, 32), 128.f);
+    return glm::vec3(32.f, glm::max(glm::ceil(ground) + 2.f, 164.f), 32.f);
+}
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
@@ -14,12 +20,12 @@ MyGL::MyGL(QWidget *parent)
       m_inventorySlotTexture(this), m_craftingSlotTexture(this), m_blockTexture(this),
       m_inventory_opened(false), m_inventory_closed(false),
       m_inventory(this, -0.75, -0.75, 1.5, 0.75),
-      m_terrain(this), m_player(this, glm::vec3(32.f, 164.f, 32.f), m_terrain),
+      m_terrain(this), m_player(this, playerSpawn(m_terrain), m_terrain),
       m_inputs(this->mapToGlobal(QPoint(width() / 2, height() / 2)).x(), this->mapToGlobal(QPoint(width() / 2, height() / 2)).y()),
       m_skyFrameBuffer(this, this->width(), this->height(), this->devicePixelRatio()),
       m_geomQuad(this), m_progSky(this),
       m_timer(), m_currFrameTime(QDateTime::currentMSecsSinceEpoch()), summed_dTs(0.f),
-      m_initialTerrainLoaded(false)
+      m_initialTerrainLoaded(false), m_frameGLStateStats()
 {
     // Connect the timer to a function so that when the timer ticks the function is executed
     connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
@@ -131,6 +137,9 @@ void MyGL::resizeGL(int w, int h) {
 // all per-frame actions here, such as performing physics updates on all
 // entities in the scene.
 void MyGL::tick() {
+    // Uniforms are set and Chunk meshes uploaded below
+    beginGLWork();
+
     // Calculate the change in time since the previous tick
     long long prevTemp = m_currFrameTime;
     m_currFrameTime = QDateTime::currentMSecsSinceEpoch();
@@ -150,7 +159,8 @@ void MyGL::tick() {
     // This both checks to see if the player is near the border of existing
     // terrain AND checks the status of any FBMWorkers that are generating
     // Chunks
-    m_terrain.tryExpansion(m_player.mcr_position, m_player.mcr_posPrev);
+    m_terrain.tryExpansion(m_player.mcr_position, m_player.mcr_posPrev,
+                           m_player.mcr_camera.getForward());
     m_terrain.checkThreadResults();
 
     update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
@@ -161,6 +171,11 @@ void MyGL::tick() {
     }
 }
 
+void MyGL::beginGLWork() {
+    makeCurrent();
+    invalidateGLState();
+}
+
 void MyGL::sendPlayerDataToGUI() const {
     emit sig_sendPlayerPos(m_player.posAsQString());
     emit sig_sendPlayerVel(m_player.velAsQString());
@@ -171,12 +186,24 @@ void MyGL::sendPlayerDataToGUI() const {
     glm::ivec2 zone(64 * glm::ivec2(glm::floor(pPos / 64.f)));
     emit sig_sendPlayerChunk(QString::fromStdString("( " + std::to_string(chunk.x) + ", " + std::to_string(chunk.y) + " )"));
     emit sig_sendPlayerTerrainZone(QString::fromStdString("( " + std::to_string(zone.x) + ", " + std::to_string(zone.y) + " )"));
+    const TerrainDrawStats &draw = m_terrain.drawStats();
+    emit sig_sendTerrainDrawStats(QString::fromStdString(std::to_string(draw.chunksDrawn) + " drawn, " +
+                                                         std::to_string(draw.chunksCulled) + " culled, " +
+                                                         std::to_string(draw.chunksOccluded) + " occluded, " +
+                                                         std::to_string(draw.drawCalls) + " draw calls"));
+    // Of the last frame's GL state changes
+    const GLStateStats &state = m_frameGLStateStats;
+    emit sig_sendGLStateStats(QString::fromStdString(std::to_string(state.skipped()) + " of " +
+                                                     std::to_string(state.total()) + " skipped"));
 }
 
 // This function is called whenever update() is called.
 // MyGL's constructor links update() to a timer that fires 60 times per second,
 // so paintGL() called at a rate of 60 frames per second.
 void MyGL::paintGL() {
+    // Qt may have changed GL state since our last frame
+    invalidateGLState();
+    resetGLStateStats();
 
     m_progFlat.setViewProjMatrix(m_player.mcr_camera.getViewProj());
     m_progLambert.setViewProjMatrix(m_player.mcr_camera.getViewProj());
@@ -223,6 +250,8 @@ void MyGL::paintGL() {
 
     glEnable(GL_DEPTH_TEST);
     //-----------------------------------------//
+
+    m_frameGLStateStats = glStateStats();
 }
 
 // TODO: Change this so it renders the nine zones of generated
@@ -231,18 +260,24 @@ void MyGL::paintGL() {
 void MyGL::renderTerrain() {
     int zoneX = 64 * static_cast<int>(glm::floor(m_player.mcr_position.x / 64.f));
     int zoneZ = 64 * static_cast<int>(glm::floor(m_player.mcr_position.z / 64.f));
-    // Draw the 3x3 terrain zones immediately surrounding the player
+    // Draw the terrain zones immediately surrounding the player,
+    // skipping Chunks outside the camera's view frustum
+    // or hidden behind solid ground
+    m_terrain.cullChunks(zoneX - 64 * TERRAIN_DRAW_RADIUS, zoneX + 64 * TERRAIN_DRAW_RADIUS,
+                         zoneZ - 64 * TERRAIN_DRAW_RADIUS, zoneZ + 64 * TERRAIN_DRAW_RADIUS,
+                         m_player.mcr_camera.mcr_position, m_player.mcr_camera.getViewProj());
     // Render opaque first
-    m_terrain.draw(zoneX - 64 * TERRAIN_DRAW_RADIUS, zoneX + 64 * TERRAIN_DRAW_RADIUS,
-                   zoneZ - 64 * TERRAIN_DRAW_RADIUS, zoneZ + 64 * TERRAIN_DRAW_RADIUS, &m_progLambert,
-                   true);
+    m_terrain.draw(&m_progLambert, true);
     // Then render transparent
-    m_terrain.draw(zoneX - 64 * TERRAIN_DRAW_RADIUS, zoneX + 64 * TERRAIN_DRAW_RADIUS,
-                   zoneZ - 64 * TERRAIN_DRAW_RADIUS, zoneZ + 64 * TERRAIN_DRAW_RADIUS, &m_progLambert,
-                   false);
+    m_terrain.draw(&m_progLambert, false);
+    // Chunks are drawn with the ChunkMeshArena's VAOs, so go back to ours
+    bindVertexArray(vao);
 }
 
 void MyGL::keyPressEvent(QKeyEvent *e) {
+    // Inventory changes rebuild its VBOs
+    beginGLWork();
+
     float amount = 1.0f;
     if (e->modifiers() & Qt::ShiftModifier){
         amount = 10.0f;
@@ -330,6 +365,9 @@ void MyGL::mouseMoveEvent(QMouseEvent *e) {
 }
 
 void MyGL::mousePressEvent(QMouseEvent *e) {
+    // Inventory changes rebuild its VBOs, and block changes remesh Chunks
+    beginGLWork();
+
     if (m_inventory_opened) {
         float x =  (e->x() - (this->width()  / 2.f)) * 2.f / this->width();
         float y = -(e->y() - (this->height() / 2.f)) * 2.f / this->height();
@@ -54,12 +54,20 @@ private:
 
     bool m_initialTerrainLoaded;
 
+    // GL binds and uniform uploads made and skipped in the last frame
+    GLStateStats m_frameGLStateStats;
+
     void moveMouseToCenter(); // Forces the mouse position to the screen's center. You should call this
                               // from within a mouse move event after reading the mouse movement so that
                               // your mouse stays within the screen bounds and is always read.
 
     void sendPlayerDataToGUI() const;
 
+    // Makes our GL context current and forgets OpenGLContext's cache
+    // of GL bindings, which Qt may have changed since we last drew.
+    // Must be called before any GL work done outside paintGL().
+    void beginGLWork();
+
     void updateInventory() {
         m_inventory.destroy();
         m_inventory.create();
@@ -108,6 +116,10 @@ signals:
     void sig_sendPlayerLook(QString) const;
     void sig_sendPlayerChunk(QString) const;
     void sig_sendPlayerTerrainZone(QString) const;
+    // Chunks drawn and culled in the last frame
+    void sig_sendTerrainDrawStats(QString) const;
+    // GL state changes skipped in the last frame
+    void sig_sendGLStateStats(QString) const;
 };
 
 
@@ -8,8 +8,13 @@
 
 
 OpenGLContext::OpenGLContext(QWidget *parent)
-    : QOpenGLWidget(parent)
-{}
+    : QOpenGLWidget(parent),
+      m_boundProgram(UNKNOWN_BINDING), m_boundArrayBuffer(UNKNOWN_BINDING),
+      m_boundVertexArray(UNKNOWN_BINDING), m_activeTextureSlot(UNKNOWN_BINDING),
+      m_boundTextures(), m_glStateStats()
+{
+    m_boundTextures.fill(UNKNOWN_BINDING);
+}
 
 OpenGLContext::~OpenGLContext()
 {}
@@ -142,3 +147,89 @@ void OpenGLContext::printShaderInfoLog(int shader)
     // Throwing here allows us to use the debugger to track down the error.
     throw;
 }
+
+void OpenGLContext::useProgram(GLuint prog) {
+    if (prog == m_boundProgram) {
+        m_glStateStats.programBindsSkipped++;
+        return;
+    }
+    m_glStateStats.programBinds++;
+    glUseProgram(prog);
+    m_boundProgram = prog;
+}
+
+void OpenGLContext::bindArrayBuffer(GLuint buf) {
+    if (buf == m_boundArrayBuffer) {
+        m_glStateStats.bufferBindsSkipped++;
+        return;
+    }
+    m_glStateStats.bufferBinds++;
+    glBindBuffer(GL_ARRAY_BUFFER, buf);
+    m_boundArrayBuffer = buf;
+}
+
+void OpenGLContext::bindVertexArray(GLuint vao) {
+    if (vao == m_boundVertexArray) {
+        m_glStateStats.vertexArrayBindsSkipped++;
+        return;
+    }
+    m_glStateStats.vertexArrayBinds++;
+    glBindVertexArray(vao);
+    m_boundVertexArray = vao;
+}
+
+void OpenGLContext::bindTexture2D(GLuint slot, GLuint texture) {
+    if (slot < m_boundTextures.size() && m_boundTextures[slot] == texture) {
+        m_glStateStats.textureBindsSkipped++;
+        return;
+    }
+    m_glStateStats.textureBinds++;
+    if (slot != m_activeTextureSlot) {
+        glActiveTexture(GL_TEXTURE0 + slot);
+        m_activeTextureSlot = slot;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (slot < m_boundTextures.size()) {
+        m_boundTextures[slot] = texture;
+    }
+}
+
+void OpenGLContext::forgetArrayBuffer(GLuint buf) {
+    if (buf == m_boundArrayBuffer) {
+        m_boundArrayBuffer = UNKNOWN_BINDING;
+    }
+}
+
+void OpenGLContext::invalidateGLState() {
+    m_boundProgram = UNKNOWN_BINDING;
+    m_boundArrayBuffer = UNKNOWN_BINDING;
+    m_boundVertexArray = UNKNOWN_BINDING;
+    m_activeTextureSlot = UNKNOWN_BINDING;
+    m_boundTextures.fill(UNKNOWN_BINDING);
+}
+
+void OpenGLContext::countUniformUpload(bool skipped) {
+    if (skipped) {
+        m_glStateStats.uniformUploadsSkipped++;
+    }
+    else {
+        m_glStateStats.uniformUploads++;
+    }
+}
+
+const GLStateStats& OpenGLContext::glStateStats() const {
+    return m_glStateStats;
+}
+
+void OpenGLContext::resetGLStateStats() {
+    m_glStateStats = GLStateStats();
+}
+
+int GLStateStats::total() const {
+    return programBinds + bufferBinds + vertexArrayBinds + textureBinds + uniformUploads + skipped();
+}
+
+int GLStateStats::skipped() const {
+    return programBindsSkipped + bufferBindsSkipped + vertexArrayBindsSkipped +
+           textureBindsSkipped + uniformUploadsSkipped;
+}
@@ -3,6 +3,30 @@
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions_3_2_Core>
 #include <QTimer>
+#include <array>
+
+// The GL state changes made through OpenGLContext's state cache
+// (and ShaderProgram's uniform uploads) since the last
+// resetGLStateStats(), and how many of each were skipped
+// because they would not have changed anything
+struct GLStateStats {
+    int programBinds, programBindsSkipped;
+    int bufferBinds, bufferBindsSkipped;
+    int vertexArrayBinds, vertexArrayBindsSkipped;
+    int textureBinds, textureBindsSkipped;
+    int uniformUploads, uniformUploadsSkipped;
+
+    GLStateStats()
+        : programBinds(0), programBindsSkipped(0),
+          bufferBinds(0), bufferBindsSkipped(0),
+          vertexArrayBinds(0), vertexArrayBindsSkipped(0),
+          textureBinds(0), textureBindsSkipped(0),
+          uniformUploads(0), uniformUploadsSkipped(0)
+    {}
+
+    int total() const;
+    int skipped() const;
+};
 
 
 class OpenGLContext
@@ -17,4 +41,38 @@ public:
     void printGLErrorLog();
     void printLinkInfoLog(int prog);
     void printShaderInfoLog(int shader);
+
+    // Cached versions of glUseProgram, glBindBuffer(GL_ARRAY_BUFFER, ...),
+    // glBindVertexArray, and glActiveTexture plus
+    // glBindTexture(GL_TEXTURE_2D, ...), which skip the call when it
+    // would bind what is already bound. Every such bind has to go
+    // through these, or the cache goes stale. GL_ELEMENT_ARRAY_BUFFER
+    // is part of the bound VAO's state, so it isn't cached.
+    void useProgram(GLuint prog);
+    void bindArrayBuffer(GLuint buf);
+    void bindVertexArray(GLuint vao);
+    void bindTexture2D(GLuint slot, GLuint texture);
+    // Deleting the bound buffer unbinds it, so call
+    // this for every buffer deleted
+    void forgetArrayBuffer(GLuint buf);
+    // Forgets everything the cache knows, for when GL state may have
+    // changed behind its back, e.g. by Qt between frames
+    void invalidateGLState();
+
+    // Counts one uniform upload by a ShaderProgram
+    void countUniformUpload(bool skipped);
+    const GLStateStats& glStateStats() const;
+    void resetGLStateStats();
+
+private:
+    // Stands for a binding the cache doesn't know
+    static const GLuint UNKNOWN_BINDING = 0xffffffffu;
+    GLuint m_boundProgram;
+    GLuint m_boundArrayBuffer;
+    GLuint m_boundVertexArray;
+    GLuint m_activeTextureSlot;
+    // The texture bound to GL_TEXTURE_2D in each of the first
+    // 16 texture slots. Slots beyond those aren't cached.
+    std::array<GLuint, 16> m_boundTextures;
+    GLStateStats m_glStateStats;
 };
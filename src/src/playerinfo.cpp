@@ -36,3 +36,11 @@ void PlayerInfo::slot_setZoneText(QString s) {
     ui->zoneLabel->setText(s);
 }
 
+void PlayerInfo::slot_setDrawText(QString s) {
+    ui->drawLabel->setText(s);
+}
+
+
+void PlayerInfo::slot_setGLStateText(QString s) {
+    ui->glStateLabel->setText(s);
+}
@@ -20,6 +20,8 @@ public slots:
     void slot_setLookText(QString);
     void slot_setChunkText(QString);
     void slot_setZoneText(QString);
+    void slot_setDrawText(QString);
+    void slot_setGLStateText(QString);
 
 private:
     Ui::PlayerInfo *ui;
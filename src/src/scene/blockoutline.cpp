@@ -54,7 +54,7 @@ void BlockOutline::create() {
     mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpq);
     mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idxData.size() * sizeof(GLuint), idxData.data(), GL_STATIC_DRAW);
     generateOpq();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpq);
+    mp_context->bindArrayBuffer(m_bufOpq);
     mp_context->glBufferData(GL_ARRAY_BUFFER, vboData.size() * sizeof(float), vboData.data(), GL_STATIC_DRAW);
 }
 
@@ -21,6 +21,7 @@ public:
     void tick(float dT, InputBundle &input) override;
 
     glm::mat4 getViewProj() const;
+    glm::vec3 getForward() const;
 
     friend class ShaderProgram;
 };
@@ -1,8 +1,12 @@
 #pragma once
 #include "shaderprogram.h"
 #include <unordered_map>
+#include <array>
 #include "smartpointerhelp.h"
 #include "chunkhelpers.h"
+#include "chunksection.h"
+#include "chunkmesharena.h"
+#include <QReadWriteLock>
 
 
 using namespace std;
@@ -13,7 +17,27 @@ glm::ivec2 toCoords(int64_t k);
 
 
 
-// One Chunk is a 16 x 256 x 16 section of the world,
+struct ChunkVBOData;
+
+// Which faces of one 16 x 16 x 16 Chunk section can be seen from
+// which others, through the section's transparent blocks. Used to
+// skip drawing Chunks hidden behind solid ground (see
+// Terrain::cullChunks). Bit g of m_connected[f] is set if some path
+// of transparent blocks inside the section joins face f to face g,
+// where faces are indexed by the Direction they face.
+struct SectionVisibility {
+    array<uint8_t, 6> m_connected;
+
+    // Every face sees every other, as in a section of air
+    SectionVisibility() {
+        m_connected.fill(0x3f);
+    }
+    bool connects(Direction from, Direction to) const {
+        return (m_connected[from] >> to) & 1;
+    }
+};
+
+// One Chunk is a 16 x 256 x 16 column of the world,
 // containing all the Minecraft blocks in that area.
 // We divide the world into Chunks in order to make
 // recomputing its VBO data faster by not having to
@@ -23,8 +47,14 @@ glm::ivec2 toCoords(int64_t k);
 // TODO have Chunk inherit from Drawable
 class Chunk : public Drawable {
 private:
-    // All of the blocks contained within this Chunk
-    array<BlockType, 65536> m_blocks;
+    // All of the blocks contained within this Chunk, stored as
+    // sixteen palette-compressed 16 x 16 x 16 sections stacked along Y.
+    // Section i holds the blocks with y in [16 * i, 16 * i + 16).
+    array<ChunkSection, 16> m_sections;
+    // Writing a block may grow a section's palette and reallocate
+    // its index array, so the sections must not be read by one thread
+    // (e.g. a neighbor's VBOWorker) while another thread writes them.
+    mutable QReadWriteLock m_sectionsLock;
     // This Chunk's four neighbors to the north, south, east, and west
     // The third input to this map just lets us use a Direction as
     // a key for this map.
@@ -33,32 +63,124 @@ private:
 
     int m_minX, m_minZ;
 
+    // The number of worker jobs that currently hold a pointer to this
+    // Chunk, either to fill it or to read it while meshing it or one
+    // of its neighbors. Only touched by the main thread.
+    // Terrain never evicts a Chunk while it is pinned.
+    int m_pinCount;
+    // Whether an FBMWorker or ZoneLoadWorker has filled in our
+    // blocks yet. Only touched by the main thread.
+    bool m_hasBlockData;
+    // Bumped each time a mesh of this Chunk is requested from a
+    // VBOWorker or built by create(). A mesh made for an older
+    // generation is out of date and is never uploaded.
+    // Only touched by the main thread.
+    uint64_t m_meshGeneration;
+
+    // The number of indices to draw from the shared QuadIndexBuffer
+    // for our transparent mesh. m_count is the same for our opaque mesh.
+    int m_countTra;
+    // Holds our meshes, and where in it they are. Our own VBOs
+    // (Drawable's m_bufOpq and m_bufTra) are never used. Null if we
+    // aren't meant to be drawn, in which case create() only counts.
+    ChunkMeshArena *mp_meshArena;
+    ChunkMeshAllocation m_meshOpq, m_meshTra;
+    // The range of y our uploaded meshes span, as found by
+    // VBOWorker::buildVBOData. Empty (m_minY > m_maxY) if we
+    // have no mesh.
+    int m_minY, m_maxY;
+    // The visibility of each of our sections, bottom first, as of
+    // our last mesh. Sections are fully see-through until then.
+    array<SectionVisibility, 16> m_sectionVisibility;
+    // The sections the last Terrain::cullChunks() reached, one bit
+    // per section, valid if m_cullFrame is Terrain's current frame.
+    // Only touched by the main thread.
+    uint16_t m_sectionsReached;
+    uint64_t m_cullFrame;
+
 public:
-    Chunk(OpenGLContext *context, int x, int z);
+    Chunk(OpenGLContext *context, int x, int z, ChunkMeshArena *meshArena = nullptr);
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
     void setBlockAt(int x, int y, int z, BlockType t);
+    // Bulk access to every block in this Chunk, using the flat
+    // 16 x 256 x 16 layout described by blockIndex().
+    // Much faster than calling getBlockAt / setBlockAt per block.
+    void decodeBlocks(BlockType *out) const;
+    // Also sets uniformSections[i] to isSectionUniform(i), read under
+    // the same lock as the blocks so the two always agree
+    void decodeBlocks(BlockType *out, array<bool, 16> *uniformSections) const;
+    void encodeBlocks(const BlockType *in);
+    // Writes the 16 x 256 slab of blocks along the given
+    // horizontal side of this Chunk (e.g. x = 15 for XPOS)
+    // to out, indexed by (i + 16 * y) where i is the block's
+    // coordinate along the slab's horizontal axis.
+    void decodeBorder(Direction side, BlockType *out) const;
+    // Is every block in the given 16 x 16 x 16 section
+    // (0 is the bottom-most) stored as one uniform type?
+    bool isSectionUniform(int section) const;
     void create() override;
-    void create(const std::vector<float> &vboDataOpaque, const vector<GLuint> &idxDataOpaque,
-                const std::vector<float> &vboDataTransparent, const vector<GLuint> &idxDataTransparent);
+    // Only uploads vertex data, into our ChunkMeshArena. Every Chunk
+    // mesh is a list of quads, drawn with indices from the shared
+    // QuadIndexBuffer by Terrain::draw().
+    void create(const ChunkVBOData &d);
+    void destroy() override;
+    int elemCount(bool opaque = true) const override;
+    // Where our opaque (or transparent) mesh is in our ChunkMeshArena
+    const ChunkMeshAllocation& mesh(bool opaque) const;
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // Clears our neighbors' pointers to us, and ours to them
+    void unlinkNeighbors();
+    // Our current neighbors, indexed by Direction
+    array<Chunk*, 6> getNeighbors() const;
+
+    // Our bounds in world space, tightened along y to our meshes.
+    // Returns false if we have nothing to draw.
+    bool meshBounds(glm::vec3 *min, glm::vec3 *max) const;
+
+    // Approximate memory used by this Chunk's block data, in bytes
+    size_t memoryUsage() const;
+    // Binary (de)serialization of this Chunk's blocks
+    void writeBlocks(ostream &out) const;
+    bool readBlocks(istream &in);
 
     // Allow Terrain to access our private members
     // if it wants to.
     friend class Terrain;
     friend class FBMWorker;
     friend class VBOWorker;
+    friend struct ChunkBlockSnapshot;
 };
 
 
+class TerrainJobToken;
+
 struct ChunkVBOData {
     Chunk* mp_chunk;
-    vector<float> m_vboDataOpaque, m_vboDataTransparent;
-    vector<GLuint> m_idxDataOpaque, m_idxDataTransparent;
+    // mp_chunk's neighbors at the time its VBO data was requested,
+    // indexed by Direction. Terrain keeps these and mp_chunk pinned
+    // until the VBO data has been collected.
+    array<Chunk*, 6> mp_neighbors;
+    // Packed vertices, CHUNK_VERTEX_WORDS words each (see chunkhelpers.h),
+    // four per quad. There is no index data; see QuadIndexBuffer.
+    vector<GLuint> m_vboDataOpaque, m_vboDataTransparent;
+    // The token of the job that built this data, if any. Once it is
+    // cancelled the data is discarded rather than sent to the GPU.
+    sPtr<TerrainJobToken> mp_token;
+    // The lowest and highest y of any block with a face in the mesh,
+    // so the mesh lies within y in [m_minY, m_maxY + 1].
+    // m_minY > m_maxY if the mesh is empty.
+    int m_minY, m_maxY;
+    // Which faces of each section see each other
+    array<SectionVisibility, 16> m_sectionVisibility;
+    // mp_chunk's m_meshGeneration when this data was requested
+    uint64_t m_meshGeneration;
 
-    ChunkVBOData(Chunk* c) : mp_chunk(c),
-                             m_vboDataOpaque{}, m_vboDataTransparent{},
-                             m_idxDataOpaque{}, m_idxDataTransparent{}
+    ChunkVBOData(Chunk* c, const array<Chunk*, 6> &neighbors,
+                 const sPtr<TerrainJobToken> &token = nullptr, uint64_t meshGeneration = 0)
+        : mp_chunk(c), mp_neighbors(neighbors),
+          m_vboDataOpaque{}, m_vboDataTransparent{}, mp_token(token),
+          m_minY(256), m_maxY(-1), m_sectionVisibility(), m_meshGeneration(meshGeneration)
     {}
 };
@@ -1,6 +1,8 @@
 #pragma once
-#include "chunk.h"
+#include "glm_includes.h"
 #include <array>
+#include <cstdint>
+#include <unordered_map>
 #include <unordered_set>
 
 using namespace std;
@@ -30,6 +32,15 @@ struct EnumHash {
     }
 };
 
+const static unordered_map<Direction, Direction, EnumHash> oppositeDirection {
+    {XPOS, XNEG},
+    {XNEG, XPOS},
+    {YPOS, YNEG},
+    {YNEG, YPOS},
+    {ZPOS, ZNEG},
+    {ZNEG, ZPOS}
+};
+
 const static unordered_set<BlockType, EnumHash> transparent_blocks {
     EMPTY, WATER
 };
@@ -39,9 +50,46 @@ const static unordered_set<BlockType, EnumHash> transparent_blocks {
 bool crossesBorder(glm::ivec3 pos, glm::ivec3 dir);
 
 
+// Chunk meshes store each vertex as CHUNK_VERTEX_WORDS (two)
+// packed 32-bit words rather than 12 floats, decoded by lambert.vert.glsl:
+//   word 0: bits  0-4  chunk-local x (0 - 16)
+//           bits  5-13 y (0 - 256)
+//           bits 14-18 chunk-local z (0 - 16)
+//           bits 19-21 the Direction the face points in
+//   word 1: bits  0-7  texture tile, column + 16 * row of the 16 x 16 texture atlas
+//           bits  8-19 the Chunk's x / 16, modulo 4096
+//           bits 20-31 the Chunk's z / 16, modulo 4096
+// There are no per-vertex UVs; the shader derives them from the
+// position, which is what lets merged faces tile their texture.
+// The shader places each Chunk relative to the camera's Chunk, which
+// is unambiguous for Chunks within 2048 Chunks of it, so every Chunk
+// can be drawn without a model matrix of its own.
+
+inline uint32_t packChunkVertexPos(glm::ivec3 pos, Direction face) {
+    return static_cast<uint32_t>(pos.x) | (static_cast<uint32_t>(pos.y) << 5) |
+           (static_cast<uint32_t>(pos.z) << 14) | (static_cast<uint32_t>(face) << 19);
+}
+
+// minX and minZ are the Chunk's corner, so multiples of 16
+inline uint32_t packChunkVertexChunk(int minX, int minZ) {
+    return ((static_cast<uint32_t>(minX / 16) & 4095u) << 8) |
+           ((static_cast<uint32_t>(minZ / 16) & 4095u) << 20);
+}
+
+// uvOrigin is a texture tile origin as stored in blockFaceUVs
+inline uint32_t packChunkVertexTile(glm::vec2 uvOrigin) {
+    uint32_t column = static_cast<uint32_t>(uvOrigin.x * 16.f + 0.5f);
+    uint32_t row = static_cast<uint32_t>(uvOrigin.y * 16.f + 0.5f);
+    return column + 16 * row;
+}
+
+
 struct VertexData {
     glm::vec4 pos;
-    // Relative UV coords, which are offset based on BlockType
+    // Relative UV coords, which are offset based on BlockType.
+    // Chunk meshes no longer upload these (lambert.vert.glsl derives
+    // them from position so merged faces tile), but they document
+    // the orientation of each face's texture that it reproduces.
     glm::vec2 uv;
     // Absolute uv info is obtained from blockFaceUVs below
     // Surface normal is based on directionVec in BlockFace
@@ -0,0 +1,161 @@
+#include "chunkmesharena.h"
+#include "quadindexbuffer.h"
+#include "drawable.h"
+#include <algorithm>
+
+// Each quad is 4 vertices of CHUNK_VERTEX_WORDS words
+#define QUAD_BYTES (4 * CHUNK_VERTEX_WORDS * sizeof(GLuint))
+
+ChunkMeshArena::ChunkMeshArena(OpenGLContext *context)
+    : mp_context(context), m_blocks(), m_batches()
+{}
+
+void ChunkMeshArena::addBlock(unsigned int quads) {
+    Block b;
+    b.capacity = std::max(quads, static_cast<unsigned int>(CHUNK_MESH_ARENA_BLOCK_QUADS));
+    b.freeRanges[0] = b.capacity;
+    b.usedQuads = 0;
+
+    mp_context->glGenBuffers(1, &b.buf);
+    mp_context->bindArrayBuffer(b.buf);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, b.capacity * QUAD_BYTES, nullptr, GL_STATIC_DRAW);
+
+    // Leave whichever VAO was bound as it was, so
+    // OpenGLContext's cache of it stays correct
+    GLint boundVAO = 0;
+    mp_context->glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &boundVAO);
+    mp_context->glGenVertexArrays(1, &b.vao);
+    mp_context->glBindVertexArray(b.vao);
+    // Integer attribute, so it must not be converted to float
+    mp_context->glEnableVertexAttribArray(CHUNK_PACKED_ATTRIB_LOCATION);
+    mp_context->glVertexAttribIPointer(CHUNK_PACKED_ATTRIB_LOCATION, CHUNK_VERTEX_WORDS, GL_UNSIGNED_INT,
+                                       CHUNK_VERTEX_WORDS * sizeof(GLuint), static_cast<void*>(0));
+    mp_context->glBindVertexArray(static_cast<GLuint>(boundVAO));
+
+    m_blocks.push_back(b);
+    m_batches.resize(2 * m_blocks.size());
+}
+
+ChunkMeshAllocation ChunkMeshArena::allocate(const vector<GLuint> &vboData) {
+    ChunkMeshAllocation a;
+    a.quads = static_cast<unsigned int>(vboData.size() * sizeof(GLuint) / QUAD_BYTES);
+    if (a.quads == 0) {
+        return a;
+    }
+    for (size_t i = 0; i < m_blocks.size() && a.block < 0; ++i) {
+        for (const auto &range : m_blocks[i].freeRanges) {
+            if (range.second >= a.quads) {
+                a.block = static_cast<int>(i);
+                a.firstQuad = range.first;
+                break;
+            }
+        }
+    }
+    if (a.block < 0) {
+        addBlock(a.quads);
+        a.block = static_cast<int>(m_blocks.size()) - 1;
+        a.firstQuad = 0;
+    }
+
+    // Take the front of the free range
+    Block &b = m_blocks[a.block];
+    unsigned int rangeSize = b.freeRanges[a.firstQuad];
+    b.freeRanges.erase(a.firstQuad);
+    if (rangeSize > a.quads) {
+        b.freeRanges[a.firstQuad + a.quads] = rangeSize - a.quads;
+    }
+    b.usedQuads += a.quads;
+
+    mp_context->bindArrayBuffer(b.buf);
+    mp_context->glBufferSubData(GL_ARRAY_BUFFER, a.firstQuad * QUAD_BYTES, a.quads * QUAD_BYTES, vboData.data());
+    return a;
+}
+
+void ChunkMeshArena::free(ChunkMeshAllocation *a) {
+    if (a->block < 0) {
+        *a = ChunkMeshAllocation();
+        return;
+    }
+    Block &b = m_blocks[a->block];
+    b.usedQuads -= a->quads;
+    unsigned int first = a->firstQuad, size = a->quads;
+    // Merge with the free ranges right after and before us
+    auto next = b.freeRanges.lower_bound(first);
+    if (next != b.freeRanges.end() && next->first == first + size) {
+        size += next->second;
+        next = b.freeRanges.erase(next);
+    }
+    if (next != b.freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == first) {
+            first = prev->first;
+            size += prev->second;
+            b.freeRanges.erase(prev);
+        }
+    }
+    b.freeRanges[first] = size;
+    *a = ChunkMeshAllocation();
+}
+
+int ChunkMeshArena::draw(const vector<const ChunkMeshAllocation*> &meshes) {
+    for (DrawBatch &batch : m_batches) {
+        batch.counts.clear();
+        batch.baseVertices.clear();
+        batch.maxQuads = 0;
+    }
+    for (const ChunkMeshAllocation *m : meshes) {
+        if (m->block < 0) {
+            continue;
+        }
+        bool index32 = QuadIndexBuffer::indexType(m->quads) == GL_UNSIGNED_INT;
+        DrawBatch &batch = m_batches[2 * m->block + index32];
+        batch.counts.push_back(static_cast<GLsizei>(6 * m->quads));
+        batch.baseVertices.push_back(static_cast<GLint>(4 * m->firstQuad));
+        batch.maxQuads = std::max(batch.maxQuads, m->quads);
+    }
+
+    int drawCalls = 0;
+    for (size_t i = 0; i < m_batches.size(); ++i) {
+        DrawBatch &batch = m_batches[i];
+        if (batch.counts.empty()) {
+            continue;
+        }
+        // Every mesh starts at index 0 of the shared quad indices,
+        // offset to its range of the block by its base vertex
+        batch.indices.assign(batch.counts.size(), nullptr);
+        mp_context->bindVertexArray(m_blocks[i / 2].vao);
+        QuadIndexBuffer::bind(mp_context, batch.maxQuads);
+        mp_context->glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(),
+                                                  QuadIndexBuffer::indexType(batch.maxQuads),
+                                                  batch.indices.data(), static_cast<GLsizei>(batch.counts.size()),
+                                                  batch.baseVertices.data());
+        drawCalls++;
+    }
+    return drawCalls;
+}
+
+void ChunkMeshArena::destroy() {
+    for (Block &b : m_blocks) {
+        mp_context->glDeleteVertexArrays(1, &b.vao);
+        mp_context->forgetArrayBuffer(b.buf);
+        mp_context->glDeleteBuffers(1, &b.buf);
+    }
+    m_blocks.clear();
+    m_batches.clear();
+}
+
+size_t ChunkMeshArena::capacityBytes() const {
+    size_t quads = 0;
+    for (const Block &b : m_blocks) {
+        quads += b.capacity;
+    }
+    return quads * QUAD_BYTES;
+}
+
+size_t ChunkMeshArena::usedBytes() const {
+    size_t quads = 0;
+    for (const Block &b : m_blocks) {
+        quads += b.usedQuads;
+    }
+    return quads * QUAD_BYTES;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <openglcontext.h>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// How many quads each ChunkMeshArena block holds (8 MB of packed
+// vertices). A typical Chunk mesh is a few hundred to a few
+// thousand quads, so one block holds hundreds of them.
+#define CHUNK_MESH_ARENA_BLOCK_QUADS (1 << 18)
+
+// Where one Chunk mesh lives in a ChunkMeshArena
+struct ChunkMeshAllocation {
+    // Index of the block holding the mesh, or -1 if it holds none
+    int block;
+    // The mesh's first quad within that block, and its size in quads
+    unsigned int firstQuad, quads;
+
+    ChunkMeshAllocation()
+        : block(-1), firstQuad(0), quads(0)
+    {}
+};
+
+// Holds the meshes of every Chunk as sub-ranges of a few large
+// VBOs ("blocks"), rather than in buffers of their own, so that
+// uploading and freeing a mesh never creates or deletes a GL
+// buffer, and every visible mesh of a block can be drawn with a
+// single glMultiDrawElementsBaseVertex call. Free space within a
+// block is kept as a list of free ranges, handed out first-fit
+// and merged with its neighbors when freed. Blocks are only
+// added, never released, until destroy().
+// Chunk meshes carry their Chunk's position in their vertices
+// (see packChunkVertexChunk), so they need no model matrix.
+// Only used from the main thread.
+class ChunkMeshArena {
+private:
+    struct Block {
+        // The VBO, and a VAO reading it as packed Chunk vertices
+        GLuint buf, vao;
+        unsigned int capacity;
+        // Free quad ranges, keyed by their first quad, mapped to their size
+        map<unsigned int, unsigned int> freeRanges;
+        unsigned int usedQuads;
+    };
+
+    OpenGLContext *mp_context;
+    vector<Block> m_blocks;
+
+    // The draws of one glMultiDrawElementsBaseVertex call,
+    // reused from frame to frame
+    struct DrawBatch {
+        vector<GLsizei> counts;
+        vector<GLint> baseVertices;
+        vector<const GLvoid*> indices;
+        unsigned int maxQuads;
+    };
+    // Two per block: meshes drawn with 16-bit indices, then 32-bit
+    vector<DrawBatch> m_batches;
+
+    // Adds a block of at least quads quads
+    void addBlock(unsigned int quads);
+
+public:
+    ChunkMeshArena(OpenGLContext *context);
+
+    // Copies vboData, a list of packed quads as built by VBOWorker,
+    // into the first free range that fits it
+    ChunkMeshAllocation allocate(const vector<GLuint> &vboData);
+    // Returns a's range to its block, and empties a
+    void free(ChunkMeshAllocation *a);
+
+    // Draws every mesh in meshes with the currently used ShaderProgram,
+    // with one draw call per block and index type that any of them
+    // use. Leaves the last block's VAO bound. Returns the number of
+    // draw calls made.
+    int draw(const vector<const ChunkMeshAllocation*> &meshes);
+
+    // Frees every block
+    void destroy();
+
+    // The bytes of VBO memory allocated, and those in use
+    size_t capacityBytes() const;
+    size_t usedBytes() const;
+};
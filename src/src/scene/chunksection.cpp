@@ -0,0 +1,178 @@
+#include "chunksection.h"
+#include <array>
+#include <algorithm>
+
+// Smallest supported index width that can address
+// paletteSize distinct palette entries
+static unsigned int bitsForPaletteSize(size_t paletteSize) {
+    if (paletteSize <= 1) {
+        return 0;
+    }
+    else if (paletteSize <= 2) {
+        return 1;
+    }
+    else if (paletteSize <= 4) {
+        return 2;
+    }
+    else if (paletteSize <= 16) {
+        return 4;
+    }
+    return 8;
+}
+
+ChunkSection::ChunkSection()
+    : m_palette{EMPTY}, m_indices(), m_bitsPerBlock(0)
+{}
+
+unsigned int ChunkSection::paletteIndexAt(unsigned int i) const {
+    if (m_bitsPerBlock == 0) {
+        return 0;
+    }
+    unsigned int bit = i * m_bitsPerBlock;
+    uint64_t mask = (uint64_t(1) << m_bitsPerBlock) - 1;
+    return static_cast<unsigned int>((m_indices[bit >> 6] >> (bit & 63)) & mask);
+}
+
+void ChunkSection::setPaletteIndexAt(unsigned int i, unsigned int paletteIdx) {
+    unsigned int bit = i * m_bitsPerBlock;
+    uint64_t mask = (uint64_t(1) << m_bitsPerBlock) - 1;
+    uint64_t &word = m_indices[bit >> 6];
+    word = (word & ~(mask << (bit & 63))) | (uint64_t(paletteIdx) << (bit & 63));
+}
+
+unsigned int ChunkSection::findOrAddToPalette(BlockType t) {
+    for (size_t p = 0; p < m_palette.size(); ++p) {
+        if (m_palette[p] == t) {
+            return static_cast<unsigned int>(p);
+        }
+    }
+    m_palette.push_back(t);
+    unsigned int bitsNeeded = bitsForPaletteSize(m_palette.size());
+    if (bitsNeeded > m_bitsPerBlock) {
+        repack(bitsNeeded);
+    }
+    return static_cast<unsigned int>(m_palette.size() - 1);
+}
+
+void ChunkSection::repack(unsigned int bitsPerBlock) {
+    ChunkSection old(*this);
+    m_bitsPerBlock = bitsPerBlock;
+    m_indices.assign(SECTION_VOLUME * bitsPerBlock / 64, 0);
+    for (unsigned int i = 0; i < SECTION_VOLUME; ++i) {
+        setPaletteIndexAt(i, old.paletteIndexAt(i));
+    }
+}
+
+BlockType ChunkSection::getBlockAt(unsigned int i) const {
+    return m_palette[paletteIndexAt(i)];
+}
+
+void ChunkSection::setBlockAt(unsigned int i, BlockType t) {
+    if (isUniform() && m_palette[0] == t) {
+        return;
+    }
+    setPaletteIndexAt(i, findOrAddToPalette(t));
+}
+
+bool ChunkSection::isUniform() const {
+    return m_bitsPerBlock == 0;
+}
+
+void ChunkSection::decode(BlockType *out) const {
+    if (isUniform()) {
+        fill_n(out, SECTION_VOLUME, m_palette[0]);
+        return;
+    }
+    unsigned int perWord = 64 / m_bitsPerBlock;
+    uint64_t mask = (uint64_t(1) << m_bitsPerBlock) - 1;
+    for (uint64_t word : m_indices) {
+        for (unsigned int j = 0; j < perWord; ++j) {
+            *out++ = m_palette[word & mask];
+            word >>= m_bitsPerBlock;
+        }
+    }
+}
+
+void ChunkSection::encode(const BlockType *in) {
+    // Map each BlockType present in the input to its palette slot
+    array<int, 256> slotOf;
+    slotOf.fill(-1);
+    m_palette.clear();
+    for (unsigned int i = 0; i < SECTION_VOLUME; ++i) {
+        if (slotOf[in[i]] < 0) {
+            slotOf[in[i]] = static_cast<int>(m_palette.size());
+            m_palette.push_back(in[i]);
+        }
+    }
+
+    m_bitsPerBlock = bitsForPaletteSize(m_palette.size());
+    if (isUniform()) {
+        m_indices.clear();
+        m_indices.shrink_to_fit();
+        return;
+    }
+    unsigned int perWord = 64 / m_bitsPerBlock;
+    m_indices.assign(SECTION_VOLUME / perWord, 0);
+    for (size_t w = 0; w < m_indices.size(); ++w) {
+        uint64_t word = 0;
+        for (unsigned int j = 0; j < perWord; ++j) {
+            word |= uint64_t(slotOf[*in++]) << (j * m_bitsPerBlock);
+        }
+        m_indices[w] = word;
+    }
+    m_palette.shrink_to_fit();
+    m_indices.shrink_to_fit();
+}
+
+size_t ChunkSection::memoryUsage() const {
+    return sizeof(ChunkSection) + m_palette.capacity() * sizeof(BlockType)
+            + m_indices.capacity() * sizeof(uint64_t);
+}
+
+void ChunkSection::write(ostream &out) const {
+    uint8_t bits = static_cast<uint8_t>(m_bitsPerBlock);
+    uint16_t paletteSize = static_cast<uint16_t>(m_palette.size());
+    out.write(reinterpret_cast<const char*>(&bits), sizeof(bits));
+    out.write(reinterpret_cast<const char*>(&paletteSize), sizeof(paletteSize));
+    out.write(reinterpret_cast<const char*>(m_palette.data()), paletteSize * sizeof(BlockType));
+    out.write(reinterpret_cast<const char*>(m_indices.data()), m_indices.size() * sizeof(uint64_t));
+}
+
+bool ChunkSection::read(istream &in) {
+    uint8_t bits = 0;
+    uint16_t paletteSize = 0;
+    in.read(reinterpret_cast<char*>(&bits), sizeof(bits));
+    in.read(reinterpret_cast<char*>(&paletteSize), sizeof(paletteSize));
+    if (!in || paletteSize == 0 || paletteSize > 256 ||
+            bits != bitsForPaletteSize(paletteSize)) {
+        return false;
+    }
+    vector<BlockType> palette(paletteSize);
+    vector<uint64_t> indices(SECTION_VOLUME * bits / 64);
+    in.read(reinterpret_cast<char*>(palette.data()), paletteSize * sizeof(BlockType));
+    in.read(reinterpret_cast<char*>(indices.data()), indices.size() * sizeof(uint64_t));
+    if (!in) {
+        return false;
+    }
+    // A corrupt section could otherwise send decode() past the end
+    // of the palette. SNOW is the last BlockType.
+    for (BlockType t : palette) {
+        if (t > SNOW) {
+            return false;
+        }
+    }
+    if (bits > 0) {
+        uint64_t mask = (uint64_t(1) << bits) - 1;
+        for (uint64_t word : indices) {
+            for (unsigned int j = 0; j < 64; j += bits) {
+                if (((word >> j) & mask) >= paletteSize) {
+                    return false;
+                }
+            }
+        }
+    }
+    m_bitsPerBlock = bits;
+    m_palette = move(palette);
+    m_indices = move(indices);
+    return true;
+}
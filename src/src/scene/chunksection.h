@@ -0,0 +1,81 @@
+#pragma once
+#include "chunkhelpers.h"
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+
+// Number of blocks along each axis of a ChunkSection, and in total
+#define SECTION_SIZE 16
+#define SECTION_VOLUME 4096
+
+// Index of the block at chunk-local (x, y, z) within a flat 16 x 256 x 16
+// array, as read and written by Chunk::decodeBlocks and Chunk::encodeBlocks.
+// Y is the outermost axis so that each ChunkSection is a contiguous
+// run of SECTION_VOLUME entries.
+inline unsigned int blockIndex(int x, int y, int z) {
+    return static_cast<unsigned int>(x + 16 * z + 256 * y);
+}
+
+// One 16 x 16 x 16 section of a Chunk.
+// Rather than storing one BlockType per block, a section
+// stores a palette of the distinct BlockTypes it contains
+// and a bit-packed array of indices into that palette.
+// Since most sections only contain a few block types,
+// each index only needs 1, 2 or 4 bits instead of a full byte.
+// The index width grows as new block types are written
+// into the section, up to 8 bits (i.e. every BlockType).
+// A section made of a single BlockType (e.g. all EMPTY sky or
+// all STONE bedrock) uses 0 bits per block and stores no
+// index array at all, just its one palette entry.
+class ChunkSection {
+private:
+    // The distinct BlockTypes stored in this section
+    vector<BlockType> m_palette;
+    // SECTION_VOLUME palette indices, m_bitsPerBlock bits each.
+    // Since m_bitsPerBlock always divides 64, an index never
+    // straddles two words. Empty when the section is uniform.
+    vector<uint64_t> m_indices;
+    unsigned int m_bitsPerBlock;
+
+    unsigned int paletteIndexAt(unsigned int i) const;
+    void setPaletteIndexAt(unsigned int i, unsigned int paletteIdx);
+    // Returns the palette index of t, adding it to the
+    // palette (and widening m_indices) if necessary
+    unsigned int findOrAddToPalette(BlockType t);
+    // Re-packs m_indices so each index takes bitsPerBlock bits
+    void repack(unsigned int bitsPerBlock);
+
+public:
+    // Creates a section filled with EMPTY
+    ChunkSection();
+
+    // i is the block's index within the section, i.e.
+    // x + 16 * z + 256 * y in section-local coordinates
+    BlockType getBlockAt(unsigned int i) const;
+    void setBlockAt(unsigned int i, BlockType t);
+
+    // Is every block in this section known to be the same type?
+    // If so, that type is m_palette[0], also returned by getBlockAt.
+    bool isUniform() const;
+
+    // Writes all SECTION_VOLUME blocks of this section to out,
+    // in the same order as the indices above
+    void decode(BlockType *out) const;
+    // Replaces the contents of this section with the
+    // SECTION_VOLUME blocks in, using the smallest
+    // palette and index width that can hold them
+    void encode(const BlockType *in);
+
+    // Approximate heap + inline memory used by this section, in bytes
+    size_t memoryUsage() const;
+
+    // Binary (de)serialization of the section exactly as it is
+    // stored in memory, used to spill evicted Chunks to disk.
+    // read() returns false if the stream does not hold a valid section,
+    // including one with an unknown BlockType or an index past the
+    // end of its palette.
+    void write(ostream &out) const;
+    bool read(istream &in);
+};
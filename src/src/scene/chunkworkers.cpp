@@ -1,9 +1,19 @@
 #include "chunkworkers.h"
+#include "zonefieldcache.h"
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 
-FBMWorker::FBMWorker(int x, int z, std::vector<Chunk*> chunksToFill, std::unordered_set<Chunk *> *chunksCompleted, QMutex* chunksCompletedLock)
-    : m_xCorner(x), m_zCorner(z), m_chunksToFill(chunksToFill),
+FBMWorker::FBMWorker(Chunk *chunkToFill, const WorldNoise &noise, ZoneFieldCache *fieldCache,
+                     std::unordered_set<Chunk *> *chunksCompleted, QMutex* chunksCompletedLock)
+    : m_xCorner(static_cast<int>(64.f * glm::floor(chunkToFill->m_minX / 64.f))),
+      m_zCorner(static_cast<int>(64.f * glm::floor(chunkToFill->m_minZ / 64.f))),
+      m_noise(noise), mp_fieldCache(fieldCache), mp_chunk(chunkToFill),
       mp_chunksCompleted(chunksCompleted), mp_chunksCompletedLock(chunksCompletedLock)
 {}
 
@@ -19,83 +29,450 @@ BlockType grasslandHeightFill(int y, int noiseHeight) {
     }
 }
 
-BlockType FBMWorker::positionToBlockType(ivec3 pos, int maxHeight, Biome b,
-                                         const unordered_map<Biome, float, EnumHash> &individualBiomeHeights) const {
+ColumnRuns::ColumnRuns()
+    : m_runs(), m_count(0)
+{}
+
+void ColumnRuns::extend(BlockType t, int y1, int top, bool dirtStoneMix) {
+    int y0 = end();
+    y1 = glm::min(y1, top);
+    if (y1 > y0) {
+        m_runs[m_count++] = BlockRun{t, y0, y1, dirtStoneMix};
+    }
+}
+
+int ColumnRuns::end() const {
+    return m_count > 0 ? m_runs[m_count - 1].y1 : 0;
+}
+
+static BlockType dirtStoneMixBlock(float noise) {
+    if (noise > 0.2f) {
+        return DIRT;
+    }
+    else {
+        return STONE;
+    }
+}
+
+BlockType FBMWorker::dirtStoneMixAt(ivec3 pos) {
+    return dirtStoneMixBlock(perlinNoise(vec3(pos) / 8.f));
+}
+
+DirtStoneMixVolume::DirtStoneMixVolume(MaterialSamplingMode mode)
+    : m_mode(mode), m_lattice()
+{
+    if (mode == FULL_MATERIAL_SAMPLING) {
+        return;
+    }
+    const int side = 16 / MATERIAL_LATTICE_SPACING + 1;
+    const int layers = 256 / MATERIAL_LATTICE_SPACING + 1;
+    m_lattice.resize(layers * latticeIndex(0, 1, 0));
+    for (int j = 0; j < layers; ++j) {
+        for (int k = 0; k < side; ++k) {
+            for (int i = 0; i < side; ++i) {
+                vec3 p = vec3(i, j, k) * float(MATERIAL_LATTICE_SPACING);
+                m_lattice[latticeIndex(i, j, k)] = perlinNoise(p / 8.f);
+            }
+        }
+    }
+}
+
+BlockType DirtStoneMixVolume::at(ivec3 pos) const {
+    if (m_mode == FULL_MATERIAL_SAMPLING) {
+        return FBMWorker::dirtStoneMixAt(pos);
+    }
+    ivec3 cell = pos / MATERIAL_LATTICE_SPACING;
+    vec3 t = vec3(pos - cell * MATERIAL_LATTICE_SPACING) / float(MATERIAL_LATTICE_SPACING);
+    auto corner = [&](int di, int dj, int dk) {
+        return m_lattice[latticeIndex(cell.x + di, cell.y + dj, cell.z + dk)];
+    };
+    float y0 = glm::mix(glm::mix(corner(0, 0, 0), corner(1, 0, 0), t.x),
+                        glm::mix(corner(0, 0, 1), corner(1, 0, 1), t.x), t.z);
+    float y1 = glm::mix(glm::mix(corner(0, 1, 0), corner(1, 1, 0), t.x),
+                        glm::mix(corner(0, 1, 1), corner(1, 1, 1), t.x), t.z);
+    return dirtStoneMixBlock(glm::mix(y0, y1, t.y));
+}
+
+ColumnRuns FBMWorker::columnRuns(float height, Biome b, const BiomeHeights &individualBiomeHeights) const {
+    // Each biome's rules are a sequence of thresholds on y, each
+    // run starting where the one before it ended
+    int top = static_cast<int>(glm::ceil(height));
+    int maxHeight = static_cast<int>(height);
+    float desertHeight = individualBiomeHeights.m_heights[DESERT];
+    ColumnRuns runs;
     switch(b) {
     case GRASSLAND:
-        if (pos.y < 127 || individualBiomeHeights.at(DESERT) >= 134) {
-            return STONE;
-        }
-        else if (pos.y < maxHeight) {
-            return DIRT;
-        }
-        else if (pos.y < 145 && individualBiomeHeights.at(DESERT) < 134) {
-            return GRASS;
+        if (desertHeight >= 134) {
+            runs.extend(STONE, top, top);
         }
         else {
-            if (perlinNoise(vec3(pos) / 8.f) > 0.2f) {
-                return DIRT;
-            }
-            else {
-                return STONE;
-            }
+            runs.extend(STONE, 127, top);
+            runs.extend(DIRT, maxHeight, top);
+            runs.extend(GRASS, 145, top);
+            runs.extend(DIRT, top, top, true);
         }
+        break;
     case DESERT:
-        if (pos.y < 127) {
-            return STONE;
-        }
+        runs.extend(STONE, 127, top);
+        runs.extend(SAND, 134, top);
         // Ensures that only desert pillars will be red clay.
         // Any height above 134 that is from biome interpolation will be sand.
-        else if (pos.y < 134 || pos.y > individualBiomeHeights.at(DESERT)) {
-            return SAND;
+        runs.extend(RED_CLAY, static_cast<int>(glm::floor(desertHeight)) + 1, top);
+        runs.extend(SAND, top, top);
+        break;
+    case MOUNTAIN:
+        runs.extend(STONE, 128, top);
+        runs.extend(DIRT, glm::max(200, maxHeight), top, true);
+        runs.extend(SNOW, top, top);
+        break;
+    case ISLAND:
+        runs.extend(STONE, 127, top);
+        runs.extend(SAND, 130, top);
+        runs.extend(DIRT, maxHeight, top);
+        runs.extend(GRASS, 145, top);
+        runs.extend(STONE, top, top);
+        break;
+    default:
+        runs.extend(LAVA, top, top);
+        break;
+    }
+    return runs;
+}
+
+// The single-point functions of every biome's height, indexed by Biome
+static float (*const heightValue[4])(vec2) = {
+    grasslandValue, mountainValue, desertValue, islandValue
+};
+
+float FBMWorker::biomeHeightAt(int x, int z, Biome b) const {
+    int index;
+    sPtr<const ZoneColumnFields> fields = mp_fieldCache->column(x, z, &index);
+    BiomeHeights heights = fields->column(index);
+    if (heights.needsHeight(b)) {
+        return heights.m_heights[b];
+    }
+    // Not part of the cached fields, since this column doesn't use it
+    return heightValue[b](vec2(x, z));
+}
+
+vec2 FBMWorker::computeBiomeSlope(ivec3 pos, Biome b) const {
+    switch(b) {
+    case DESERT:
+        // Columns on the zone's edge read their neighbors' fields
+        return vec2(biomeHeightAt(pos.x + 1, pos.z, b) - biomeHeightAt(pos.x - 1, pos.z, b),
+                    biomeHeightAt(pos.x, pos.z + 1, b) - biomeHeightAt(pos.x, pos.z - 1, b));
+    default:
+        return vec2(0.f);
+    }
+}
+
+static void biomeBatch(const vec2 *points, vec2 *out) {
+    vec2 biomeUV[NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        biomeUV[i] = points[i] / 750.f;
+    }
+    biomeValueBatch(biomeUV, out);
+}
+
+// The batch functions of every biome's height, indexed by Biome
+static void (*const heightBatch[4])(const vec2*, float*) = {
+    grasslandValueBatch, mountainValueBatch, desertValueBatch, islandValueBatch
+};
+
+static float latticeError(float a, float b) {
+    return glm::abs(a - b);
+}
+
+static float latticeError(vec2 a, vec2 b) {
+    vec2 d = glm::abs(a - b);
+    return glm::max(d.x, d.y);
+}
+
+// Fills field, indexed by ZoneColumnFields::columnIndex(), by sampling
+// evaluate() on the lattice of the zone at (xCorner, zCorner) and
+// interpolating between lattice points. Each lattice cell is also
+// sampled at its center and the midpoints of its four edges, and is
+// evaluated at every column instead if interpolation is off by more
+// than tolerance at any of those, or if mayStep() says the field may
+// jump somewhere within the cell. mayStep() is given the cell's four
+// corners and five test points. Cells for which cellNeeded is false
+// are skipped, along with any points only they use.
+// Returns the number of cells evaluated at every column.
+template<typename T, typename Evaluate, typename MayStep>
+static int sampleOnLattice(int xCorner, int zCorner, Evaluate evaluate, float tolerance, MayStep mayStep,
+                           const vector<bool> &cellNeeded, vector<T> &field) {
+    const int cells = 64 / ZONE_LATTICE_SPACING;
+    const int half = ZONE_LATTICE_SPACING / 2;
+    auto needed = [&](int i, int j) {
+        return i >= 0 && i < cells && j >= 0 && j < cells && cellNeeded[i + cells * j];
+    };
+
+    // Evaluates the listed points, padding the last batch, and
+    // scatters the results to their indices in values
+    auto evaluateAll = [&](vector<vec2> points, const vector<int> &indices, vector<T> &values) {
+        if (points.empty()) {
+            return;
         }
-        else {
-            return RED_CLAY;
+        size_t count = points.size();
+        points.resize((count + NOISE_BATCH_SIZE - 1) / NOISE_BATCH_SIZE * NOISE_BATCH_SIZE, points.back());
+        vector<T> results(points.size());
+        for (size_t i = 0; i < points.size(); i += NOISE_BATCH_SIZE) {
+            evaluate(&points[i], &results[i]);
         }
-    case MOUNTAIN:
-        if (pos.y < 128) {
-            return STONE;
+        for (size_t i = 0; i < count; ++i) {
+            values[indices[i]] = results[i];
         }
-        else if (pos.y < 200 || pos.y < maxHeight) {
-            if (perlinNoise(vec3(pos) / 8.f) > 0.2f) {
-                return DIRT;
+    };
+
+    // The lattice points, including those on the zone's far edges,
+    // then the center of every lattice cell we need and the midpoints
+    // of their edges along x and along z. Neighboring cells share the
+    // points on their common edge.
+    vector<vec2> latticePoints, centerPoints, xEdgePoints, zEdgePoints;
+    vector<int> latticeIndices, centerIndices, xEdgeIndices, zEdgeIndices;
+    for (int j = 0; j <= cells; ++j) {
+        for (int i = 0; i <= cells; ++i) {
+            vec2 corner(xCorner + i * ZONE_LATTICE_SPACING, zCorner + j * ZONE_LATTICE_SPACING);
+            if (needed(i, j) || needed(i - 1, j) || needed(i, j - 1) || needed(i - 1, j - 1)) {
+                latticePoints.push_back(corner);
+                latticeIndices.push_back(i + (cells + 1) * j);
             }
-            else {
-                return STONE;
+            if (needed(i, j)) {
+                centerPoints.push_back(corner + vec2(half));
+                centerIndices.push_back(i + cells * j);
+            }
+            if (needed(i, j) || needed(i, j - 1)) {
+                xEdgePoints.push_back(corner + vec2(half, 0));
+                xEdgeIndices.push_back(i + cells * j);
+            }
+            if (needed(i, j) || needed(i - 1, j)) {
+                zEdgePoints.push_back(corner + vec2(0, half));
+                zEdgeIndices.push_back(i + (cells + 1) * j);
             }
         }
-        else {
-            return SNOW;
+    }
+    vector<T> lattice((cells + 1) * (cells + 1)), centers(cells * cells);
+    vector<T> xEdges(cells * (cells + 1)), zEdges((cells + 1) * cells);
+    evaluateAll(latticePoints, latticeIndices, lattice);
+    evaluateAll(centerPoints, centerIndices, centers);
+    evaluateAll(xEdgePoints, xEdgeIndices, xEdges);
+    evaluateAll(zEdgePoints, zEdgeIndices, zEdges);
+
+    int refined = 0;
+    for (int j = 0; j < cells; ++j) {
+        for (int i = 0; i < cells; ++i) {
+            if (!needed(i, j)) {
+                continue;
+            }
+            const T &v00 = lattice[i + (cells + 1) * j], &v10 = lattice[i + 1 + (cells + 1) * j];
+            const T &v01 = lattice[i + (cells + 1) * (j + 1)], &v11 = lattice[i + 1 + (cells + 1) * (j + 1)];
+            int x0 = i * ZONE_LATTICE_SPACING, z0 = j * ZONE_LATTICE_SPACING;
+
+            // Each test point and what interpolation gives there. Bilinear
+            // interpolation at the center is the corners' average, and
+            // at an edge's midpoint the average of that edge's corners.
+            const T samples[9] = {v00, v10, v01, v11,
+                                  centers[i + cells * j],
+                                  xEdges[i + cells * j], xEdges[i + cells * (j + 1)],
+                                  zEdges[i + (cells + 1) * j], zEdges[i + 1 + (cells + 1) * j]};
+            const T interpolated[5] = {0.25f * (v00 + v10 + v01 + v11),
+                                       0.5f * (v00 + v10), 0.5f * (v01 + v11),
+                                       0.5f * (v00 + v01), 0.5f * (v10 + v11)};
+            bool interpolable = !mayStep(samples, 9);
+            for (int k = 0; k < 5 && interpolable; ++k) {
+                interpolable = latticeError(samples[4 + k], interpolated[k]) <= tolerance;
+            }
+            if (!interpolable) {
+                // A lattice cell is exactly one batch
+                vec2 points[NOISE_BATCH_SIZE];
+                T values[NOISE_BATCH_SIZE];
+                for (int k = 0; k < NOISE_BATCH_SIZE; ++k) {
+                    points[k] = vec2(xCorner + x0 + k % ZONE_LATTICE_SPACING,
+                                     zCorner + z0 + k / ZONE_LATTICE_SPACING);
+                }
+                evaluate(points, values);
+                for (int k = 0; k < NOISE_BATCH_SIZE; ++k) {
+                    field[ZoneColumnFields::columnIndex(x0 + k % ZONE_LATTICE_SPACING,
+                                                        z0 + k / ZONE_LATTICE_SPACING)] = values[k];
+                }
+                refined++;
+                continue;
+            }
+
+            for (int dz = 0; dz < ZONE_LATTICE_SPACING; ++dz) {
+                float tz = dz / float(ZONE_LATTICE_SPACING);
+                for (int dx = 0; dx < ZONE_LATTICE_SPACING; ++dx) {
+                    float tx = dx / float(ZONE_LATTICE_SPACING);
+                    field[ZoneColumnFields::columnIndex(x0 + dx, z0 + dz)] =
+                            glm::mix(glm::mix(v00, v10, tx), glm::mix(v01, v11, tx), tz);
+                }
+            }
         }
+    }
+    return refined;
+}
+
+// For fields that are continuous everywhere
+template<typename T>
+static bool neverSteps(const T*, int) {
+    return false;
+}
+
+// Whether desertTerraceHeight() may step anywhere within a lattice
+// cell whose desert noise samples are the count values in noise.
+// Noise between samples may stray past them by up to the tolerance.
+static bool desertMayStep(const float *noise, int count) {
+    float lo = noise[0], hi = noise[0];
+    for (int i = 1; i < count; ++i) {
+        lo = glm::min(lo, noise[i]);
+        hi = glm::max(hi, noise[i]);
+    }
+    return hi >= DESERT_TERRACE_MIN - ZONE_LATTICE_DESERT_NOISE_TOLERANCE &&
+           lo <= DESERT_TERRACE_MAX + ZONE_LATTICE_DESERT_NOISE_TOLERANCE;
+}
+
+BiomeHeights::BiomeHeights(vec2 biome)
+    : m_blend(smoothstep(0.f, 1.f, smoothstep(0.25f, 0.75f, 0.5f * (biome + glm::vec2(1.f))))),
+      m_heights{0.f, 0.f, 0.f, 0.f}
+{}
+
+bool BiomeHeights::needsHeight(Biome b) const {
+    switch (b) {
+    case GRASSLAND:
+        return m_blend.x < 1.f && m_blend.y > 0.f;
+    case MOUNTAIN:
+        return m_blend.x > 0.f && m_blend.y > 0.f;
+    case DESERT:
+        // Also consulted by GRASSLAND columns
+        return m_blend.x < 1.f && (m_blend.y < 1.f || m_blend.x < 0.5f);
     case ISLAND:
-        if (pos.y < 127) {
-            return STONE;
-        }
-        else if (pos.y < 130) {
-            return SAND;
-        }
-        else if (pos.y < maxHeight) {
-            return DIRT;
+        return m_blend.x > 0.f && m_blend.y < 1.f;
+    default:
+        return true;
+    }
+}
+
+float BiomeHeights::blendedHeight() const {
+    // Unneeded heights are 0 and only ever weighted by exactly 0,
+    // so this matches blending every biome's true height
+    float mixDesertIsland = mix(m_heights[DESERT], m_heights[ISLAND], m_blend.x);
+    float mixGrasslandMountain = mix(m_heights[GRASSLAND], m_heights[MOUNTAIN], m_blend.x);
+    return mix(mixDesertIsland, mixGrasslandMountain, m_blend.y);
+}
+
+ZoneColumnFields::ZoneColumnFields(int xCorner, int zCorner, HeightSamplingMode mode)
+    : m_biome(64 * 64), m_heights(), m_surfaceHeight(64 * 64),
+      m_refinedBiomeCells(0), m_refinedHeightCells{0, 0, 0, 0}
+{
+    for (vector<float> &h : m_heights) {
+        h.resize(64 * 64);
+    }
+
+    // The biome comes first, since it decides which heights each column needs
+    const int cells = 64 / ZONE_LATTICE_SPACING;
+    if (mode == FULL_HEIGHT_SAMPLING) {
+        for (int z = 0; z < 64; ++z) {
+            for (int x = 0; x < 64; x += NOISE_BATCH_SIZE) {
+                vec2 points[NOISE_BATCH_SIZE];
+                for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                    points[i] = vec2(xCorner + x + i, zCorner + z);
+                }
+                // A row of columns is contiguous in every field
+                biomeBatch(points, &m_biome[columnIndex(x, z)]);
+            }
         }
-        else if (pos.y < 145) {
-            return GRASS;
+    }
+    else {
+        m_refinedBiomeCells = sampleOnLattice(xCorner, zCorner, biomeBatch, ZONE_LATTICE_BIOME_TOLERANCE,
+                                              neverSteps<vec2>, vector<bool>(cells * cells, true), m_biome);
+    }
+
+    for (int b = 0; b < 4; ++b) {
+        Biome biome = static_cast<Biome>(b);
+        if (mode == FULL_HEIGHT_SAMPLING) {
+            for (int z = 0; z < 64; ++z) {
+                for (int x = 0; x < 64; x += NOISE_BATCH_SIZE) {
+                    bool needed = false;
+                    for (int i = 0; i < NOISE_BATCH_SIZE && !needed; ++i) {
+                        needed = BiomeHeights(m_biome[columnIndex(x + i, z)]).needsHeight(biome);
+                    }
+                    if (!needed) {
+                        continue;
+                    }
+                    vec2 points[NOISE_BATCH_SIZE];
+                    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+                        points[i] = vec2(xCorner + x + i, zCorner + z);
+                    }
+                    heightBatch[b](points, &m_heights[b][columnIndex(x, z)]);
+                }
+            }
         }
         else {
-            return STONE;
+            vector<bool> cellNeeded(cells * cells, false);
+            for (int z = 0; z < 64; ++z) {
+                for (int x = 0; x < 64; ++x) {
+                    if (BiomeHeights(m_biome[columnIndex(x, z)]).needsHeight(biome)) {
+                        cellNeeded[x / ZONE_LATTICE_SPACING + cells * (z / ZONE_LATTICE_SPACING)] = true;
+                    }
+                }
+            }
+            // Each height is refined on its own, since they vary at very
+            // different scales (mountains are far rougher than islands)
+            if (biome == DESERT) {
+                // The desert's terraces are steps in its height, which no
+                // finite set of test points is sure to catch. Its noise
+                // has none, so interpolate that, and evaluate every column
+                // of the cells whose noise reaches the terraces.
+                vector<float> &desert = m_heights[DESERT];
+                m_refinedHeightCells[b] = sampleOnLattice(xCorner, zCorner, desertNoiseBatch,
+                                                          ZONE_LATTICE_DESERT_NOISE_TOLERANCE, desertMayStep,
+                                                          cellNeeded, desert);
+                for (int i = 0; i < 64 * 64; ++i) {
+                    if (cellNeeded[(i % 64) / ZONE_LATTICE_SPACING + cells * (i / 64 / ZONE_LATTICE_SPACING)]) {
+                        desert[i] = desertTerraceHeight(desert[i]);
+                    }
+                }
+            }
+            else {
+                m_refinedHeightCells[b] = sampleOnLattice(xCorner, zCorner, heightBatch[b], ZONE_LATTICE_HEIGHT_TOLERANCE,
+                                                          neverSteps<float>, cellNeeded, m_heights[b]);
+            }
         }
-    default:
-        return LAVA;
+    }
+
+    for (int i = 0; i < 64 * 64; ++i) {
+        m_surfaceHeight[i] = glm::clamp(column(i).blendedHeight(), 0.f, 255.f);
     }
 }
 
-vec2 FBMWorker::computeBiomeSlope(ivec3 pos, Biome b) const {
-    switch(b) {
-    case DESERT:
-        return vec2(desertValue(vec2(pos.x + 1, pos.z)) - desertValue(vec2(pos.x - 1, pos.z)),
-                    desertValue(vec2(pos.x, pos.z + 1)) - desertValue(vec2(pos.x, pos.z - 1)));
-    default:
-        return vec2(0.f);
+BiomeHeights ZoneColumnFields::column(int index) const {
+    BiomeHeights heights(m_biome[index]);
+    for (int b = 0; b < 4; ++b) {
+        if (heights.needsHeight(static_cast<Biome>(b))) {
+            heights.m_heights[b] = m_heights[b][index];
+        }
     }
+    return heights;
+}
+
+std::atomic<HeightSamplingMode> FBMWorker::s_heightSamplingMode(FULL_HEIGHT_SAMPLING);
+
+void FBMWorker::setHeightSamplingMode(HeightSamplingMode mode) {
+    s_heightSamplingMode = mode;
+}
+
+HeightSamplingMode FBMWorker::getHeightSamplingMode() {
+    return s_heightSamplingMode;
+}
+
+std::atomic<MaterialSamplingMode> FBMWorker::s_materialSamplingMode(FULL_MATERIAL_SAMPLING);
+
+void FBMWorker::setMaterialSamplingMode(MaterialSamplingMode mode) {
+    s_materialSamplingMode = mode;
+}
+
+MaterialSamplingMode FBMWorker::getMaterialSamplingMode() {
+    return s_materialSamplingMode;
 }
 
 Biome FBMWorker::biomeMap(glm::vec2 val) const {
@@ -125,222 +502,547 @@ Biome FBMWorker::biomeMap(glm::vec2 val) const {
 // (0, 0) -> (1, 1) is grassland
 
 void FBMWorker::run() {
-    for (Chunk* c : m_chunksToFill) {
-        // Fill Chunks with block data based on noise functions
+    WorldNoiseScope noiseScope(m_noise);
+    // Blocks are generated into this flat buffer and then
+    // palette-encoded into the Chunk in one step
+    vector<BlockType> blocks(65536, EMPTY);
+    // The noise fields of every column in the zone, which the rest
+    // of the zone's Chunks and other zones' slopes will use too
+    sPtr<const ZoneColumnFields> fields = mp_fieldCache->get(m_xCorner, m_zCorner);
+    // Shared by every FBMWorker, as it depends only on chunk-local positions
+    sPtr<const DirtStoneMixVolume> dirtStoneMix = mp_fieldCache->dirtStoneMix(s_materialSamplingMode);
+    Chunk *c = mp_chunk;
+
+    // Fill the Chunk with block data based on noise functions
+    for (int z = 0; z < 16; ++z) {
         for (int x = 0; x < 16; ++x) {
-            for (int z = 0; z < 16; ++z) {
-                glm::vec2 p(x + c->m_minX, z + c->m_minZ);
-                vec2 biome = 0.5f * (biomeValue(p / 750.f) + glm::vec2(1.f)); // [0, 1)
-                // Low Y is desert/island, high Y is grassland/mountain
-                // Low X is desert/grassland, high X is island/mountain
-                biome = smoothstep(0.f, 1.f, smoothstep(0.25f, 0.75f, biome));
-                unordered_map<Biome, float, EnumHash> biomeHeights {
-                    {GRASSLAND, grasslandValue(p)},
-                    {DESERT, desertValue(p)},
-                    {MOUNTAIN, mountainValue(p)},
-                    {ISLAND, islandValue(p)}
-                };
-
-                float mixDesertIsland = mix(biomeHeights[DESERT], biomeHeights[ISLAND], biome.x);
-                float mixGrasslandMountain = mix(biomeHeights[GRASSLAND], biomeHeights[MOUNTAIN], biome.x);
-                float mixAll = mix(mixDesertIsland, mixGrasslandMountain, biome.y);
-                mixAll = clamp(mixAll, 0.f, 255.f);
-                Biome currBiome = biomeMap(biome);
-
-                // Fill in terrain
-                for (int i = 0; i < mixAll; ++i) {
-                    BlockType t = positionToBlockType(ivec3(x, i, z), static_cast<int>(mixAll), currBiome, biomeHeights);
-                    c->setBlockAt(x, i, z, t);
+            int column = ZoneColumnFields::columnIndex(c->m_minX - m_xCorner + x, c->m_minZ - m_zCorner + z);
+            BiomeHeights biomeHeights = fields->column(column);
+            float mixAll = fields->m_surfaceHeight[column];
+            Biome currBiome = biomeMap(biomeHeights.m_blend);
+
+            // Fill in terrain, then the water table above it,
+            // one run of blocks at a time
+            ColumnRuns runs = columnRuns(mixAll, currBiome, biomeHeights);
+            runs.extend(WATER, 128, 128);
+            for (int r = 0; r < runs.m_count; ++r) {
+                const BlockRun &run = runs.m_runs[r];
+                BlockType *column = &blocks[blockIndex(x, run.y0, z)];
+                if (run.dirtStoneMix) {
+                    for (int i = run.y0; i < run.y1; ++i, column += 256) {
+                        *column = dirtStoneMix->at(ivec3(x, i, z));
+                    }
                 }
-                // Do water table
-                for (int i = 127; i >= 0; --i) {
-                    if (c->getBlockAt(x, i, z) != EMPTY) {
-                        break;
+                else {
+                    for (int i = run.y0; i < run.y1; ++i, column += 256) {
+                        *column = run.type;
                     }
-                    c->setBlockAt(x, i, z, WATER);
                 }
+            }
 #if 0
-                vec2 biome = 0.5f * (biomeValue(p / 1024.f) + glm::vec2(1.f)); // [0, 1)
-                glm::vec4 allBiomes(desertValue(p / 256.f),
-                                    mountainValue(p / 256.f),
-                                    grasslandValue(p / 256.f),
-                                    islandValue(p / 256.f));
-                float mixLowX = glm::mix(allBiomes[0], allBiomes[3], glm::smoothstep(0.45f, 0.55f, biome.x));
-                float mixHiX = glm::mix(allBiomes[1], allBiomes[2], glm::smoothstep(0.45f, 0.55f, biome.x));
-                float interpolatedBiomeHeight = glm::mix(mixLowX, mixHiX, glm::smoothstep(0.45f, 0.55f, biome.y));
-
-                // If the biome value is within 0.1 of
-                // 0 on X or Y, then we compute the
-                // interpolation
-                if (biome.x < 0.5f) {
-                    // (0, 0) is desert
-                    if (biome.y < 0) {
-                        for (int i = 0; i < DESERT_MAX_HEIGHT; ++i) {
-                            if (i > interpolatedBiomeHeight) break;
-                            c->setBlockAt(x, i, z, SAND);
-                        }
-                    }
-                    // (0, 0.5) is mountain
-                    else {
-                        for (int i = 0; i < MOUNTAIN_MAX_HEIGHT; ++i) {
-                            if (i > interpolatedBiomeHeight) break;
-                            c->setBlockAt(x, i, z, STONE);
-                        }
+            vec2 biome = 0.5f * (biomeValue(p / 1024.f) + glm::vec2(1.f)); // [0, 1)
+            glm::vec4 allBiomes(desertValue(p / 256.f),
+                                mountainValue(p / 256.f),
+                                grasslandValue(p / 256.f),
+                                islandValue(p / 256.f));
+            float mixLowX = glm::mix(allBiomes[0], allBiomes[3], glm::smoothstep(0.45f, 0.55f, biome.x));
+            float mixHiX = glm::mix(allBiomes[1], allBiomes[2], glm::smoothstep(0.45f, 0.55f, biome.x));
+            float interpolatedBiomeHeight = glm::mix(mixLowX, mixHiX, glm::smoothstep(0.45f, 0.55f, biome.y));
+
+            // If the biome value is within 0.1 of
+            // 0 on X or Y, then we compute the
+            // interpolation
+            if (biome.x < 0.5f) {
+                // (0, 0) is desert
+                if (biome.y < 0) {
+                    for (int i = 0; i < DESERT_MAX_HEIGHT; ++i) {
+                        if (i > interpolatedBiomeHeight) break;
+                        c->setBlockAt(x, i, z, SAND);
                     }
                 }
+                // (0, 0.5) is mountain
                 else {
-                    // (0.5, 0) is islands
-                    if (biome.y < 0) {
-                        for (int i = 0; i < ISLAND_MAX_HEIGHT; ++i) {
-                            if (i > interpolatedBiomeHeight) break;
-                            c->setBlockAt(x, i, z, SAND);
-                        }
+                    for (int i = 0; i < MOUNTAIN_MAX_HEIGHT; ++i) {
+                        if (i > interpolatedBiomeHeight) break;
+                        c->setBlockAt(x, i, z, STONE);
                     }
-                    // (0.5, 1) is grassland
-                    else {
-                        for (int i = 0; i < GRASSLAND_MAX_HEIGHT; ++i) {
-                            if (i > interpolatedBiomeHeight) break;
-                            c->setBlockAt(x, i, z, GRASS);
-                        }
+                }
+            }
+            else {
+                // (0.5, 0) is islands
+                if (biome.y < 0) {
+                    for (int i = 0; i < ISLAND_MAX_HEIGHT; ++i) {
+                        if (i > interpolatedBiomeHeight) break;
+                        c->setBlockAt(x, i, z, SAND);
                     }
                 }
-                for (int i = 127; i >= 0; --i) {
-                    if (c->getBlockAt(x, i, z) != EMPTY) {
-                        break;
+                // (0.5, 1) is grassland
+                else {
+                    for (int i = 0; i < GRASSLAND_MAX_HEIGHT; ++i) {
+                        if (i > interpolatedBiomeHeight) break;
+                        c->setBlockAt(x, i, z, GRASS);
                     }
-                    c->setBlockAt(x, i, z, WATER);
                 }
+            }
+            for (int i = 127; i >= 0; --i) {
+                if (c->getBlockAt(x, i, z) != EMPTY) {
+                    break;
+                }
+                c->setBlockAt(x, i, z, WATER);
+            }
 #endif
 #if 0
 #define WATER_THRESHOLD 0.125f
-                float height = combinedNoise(p / 256.f);
-                float water = 10.f * riverNoise(p / 256.f);
-                water = water - WATER_THRESHOLD;
-                height *= glm::smoothstep(- WATER_THRESHOLD, 1.f - WATER_THRESHOLD, water);
-                for (int i = 0; i <= static_cast<int>(height * 16) + 96; ++i) {
-                    c->setBlockAt(x, i, z, grasslandHeightFill(i, static_cast<int>(height * 16) + 96));
+            float height = combinedNoise(p / 256.f);
+            float water = 10.f * riverNoise(p / 256.f);
+            water = water - WATER_THRESHOLD;
+            height *= glm::smoothstep(- WATER_THRESHOLD, 1.f - WATER_THRESHOLD, water);
+            for (int i = 0; i <= static_cast<int>(height * 16) + 96; ++i) {
+                c->setBlockAt(x, i, z, grasslandHeightFill(i, static_cast<int>(height * 16) + 96));
+            }
+            // Carve water out based on absolute value Perlin noise
+            if (water < 0.f) {
+                for (int i = water; i < 10; ++i) {
+                    c->setBlockAt(x, i + 87, z, WATER);
                 }
-                // Carve water out based on absolute value Perlin noise
-                if (water < 0.f) {
-                    for (int i = water; i < 10; ++i) {
-                        c->setBlockAt(x, i + 87, z, WATER);
+                for (int i = 97; i < 256; ++i) {
+                    if (c->getBlockAt(x, i, z) == EMPTY) {
+                        break;
                     }
-                    for (int i = 97; i < 256; ++i) {
-                        if (c->getBlockAt(x, i, z) == EMPTY) {
-                            break;
-                        }
-                        else {
-                            c->setBlockAt(x, i, z, EMPTY);
-                        }
+                    else {
+                        c->setBlockAt(x, i, z, EMPTY);
                     }
                 }
-#endif
             }
+#endif
         }
     }
+    c->encodeBlocks(blocks.data());
+    // Add the Chunk to the list of Chunks that are ready
+    // for VBO creation by the main thread
     mp_chunksCompletedLock->lock();
-    for (Chunk* c : m_chunksToFill) {
-        // Add the Chunks to the list of Chunks that are ready
-        // for VBO creation by the main thread
-        mp_chunksCompleted->insert(c);
-    }
+    mp_chunksCompleted->insert(c);
     mp_chunksCompletedLock->unlock();
 }
 
-VBOWorker::VBOWorker(Chunk *c, vector<ChunkVBOData> *dat, QMutex *datLock)
-    : mp_chunk(c), mp_chunkVBOsCompleted(dat), mp_chunkVBOsCompletedLock(datLock)
+VBOWorker::VBOWorker(Chunk *c, const sPtr<TerrainJobToken> &token,
+                     vector<ChunkVBOData> *dat, QMutex *datLock)
+    : mp_chunk(c), m_neighbors(c->getNeighbors()), mp_token(token),
+      mp_chunkVBOsCompleted(dat), mp_chunkVBOsCompletedLock(datLock),
+      m_meshGeneration(++c->m_meshGeneration)
 {}
 
 
+// isTransparent() for every possible BlockType, so the meshing
+// kernel can classify blocks without hashing
+static const array<bool, 256> transparentTable = [] {
+    array<bool, 256> table;
+    table.fill(false);
+    for (BlockType t : transparent_blocks) {
+        table[t] = true;
+    }
+    return table;
+}();
+
 bool isTransparent(BlockType t) {
-    return transparent_blocks.find(t) != transparent_blocks.end();
+    return transparentTable[t];
 }
 
-void VBOWorker::appendVBOData(vector<float> &vboData, vector<GLuint> &idxData,
-                              const BlockFace &f, BlockType curr, ivec3 xyz, unsigned int &maxIdx) {
-
-    int x = xyz.x, y = xyz.y, z = xyz.z;
-
+void VBOWorker::appendVBOData(vector<GLuint> &vboData, const BlockFace &f, BlockType curr,
+                              ivec3 xyz, ivec3 extent) {
     const array<VertexData, 4> &vertDat = f.vertices;
-    glm::vec2 uvOffset = blockFaceUVs.at(curr).at(f.direction);
+    // Every vertex of a face gets the same texture tile. lambert.vert.glsl
+    // works out where in the tile each fragment falls from its position,
+    // so the tile repeats once per block across merged faces.
+    GLuint tile = packChunkVertexTile(blockFaceUVs.at(curr).at(f.direction));
     for (const VertexData &vd : vertDat) {
-        // Pos
-        vboData.push_back(vd.pos.x + x);
-        vboData.push_back(vd.pos.y + y);
-        vboData.push_back(vd.pos.z + z);
-        vboData.push_back(vd.pos.w);
-        // Nor
-        vboData.push_back(f.directionVec.x);
-        vboData.push_back(f.directionVec.y);
-        vboData.push_back(f.directionVec.z);
-        vboData.push_back(0);
-        // UV
-        vboData.push_back(vd.uv.x + uvOffset.x);
-        vboData.push_back(vd.uv.y + uvOffset.y);
-        // Cosine power
-        // TODO make this not hard-coded
-        vboData.push_back(1.f);
-        // Anim flag
-        // TODO make this not hard-coded
-        vboData.push_back(0.f);
-    }
-    idxData.push_back(0 + maxIdx);
-    idxData.push_back(1 + maxIdx);
-    idxData.push_back(2 + maxIdx);
-    idxData.push_back(0 + maxIdx);
-    idxData.push_back(2 + maxIdx);
-    idxData.push_back(3 + maxIdx);
-    maxIdx += 4;
+        ivec3 pos = xyz + ivec3(vd.pos) * extent;
+        vboData.push_back(packChunkVertexPos(pos, f.direction));
+        vboData.push_back(tile);
+    }
 }
 
-void VBOWorker::run() {
-    ChunkVBOData c(mp_chunk);
-    std::vector<float> vboDataOpaque, vboDataTransparent;
-    std::vector<GLuint> idxDataOpaque, idxDataTransparent;
-    GLuint maxIdxOpq = 0, maxIdxTra = 0;
-    for (int x = 0; x < 16; ++x) {
+ChunkBlockSnapshot::ChunkBlockSnapshot(const Chunk *c, const array<Chunk*, 6> &neighbors)
+    : m_blocks(65536), m_borders(), m_uniformSections()
+{
+    c->decodeBlocks(m_blocks.data(), &m_uniformSections);
+    for (Direction side : {XPOS, XNEG, ZPOS, ZNEG}) {
+        Chunk *neighbor = neighbors[side];
+        m_borders[side].assign(16 * 256, EMPTY);
+        if (neighbor != nullptr) {
+            // The slab of the neighbor that touches us is on its opposite side
+            neighbor->decodeBorder(oppositeDirection.at(side), m_borders[side].data());
+        }
+    }
+}
+
+// Row masks cover x in [-1, 16], with x stored in bit (x + 1)
+#define ROW_INTERIOR 0x1fffeu
+#define ROWS_PER_LAYER 18
+// Row (y, z) of the masks, for y in [-1, 256] and z in [-1, 16]
+static inline int maskRow(int y, int z) {
+    return (z + 1) + ROWS_PER_LAYER * (y + 1);
+}
+
+ChunkFaceMasks::ChunkFaceMasks(const ChunkBlockSnapshot &snapshot)
+    : m_solid(ROWS_PER_LAYER * 258, 0), m_opaque(ROWS_PER_LAYER * 258, 0), m_faces()
+{
+    const vector<BlockType> &blocks = snapshot.m_blocks;
+    auto setBit = [this](int row, int bit, BlockType t) {
+        if (t != EMPTY) {
+            m_solid[row] |= 1u << bit;
+            if (!isTransparent(t)) {
+                m_opaque[row] |= 1u << bit;
+            }
+        }
+    };
+
+    for (int y = 0; y < 256; ++y) {
+        // The interior of the Chunk. Uniform sections fill whole rows at once.
+        if (snapshot.m_uniformSections[y / 16]) {
+            BlockType t = blocks[blockIndex(0, y, 0)];
+            uint32_t solid = t != EMPTY ? ROW_INTERIOR : 0;
+            uint32_t opaque = t != EMPTY && !isTransparent(t) ? ROW_INTERIOR : 0;
+            for (int z = 0; z < 16; ++z) {
+                m_solid[maskRow(y, z)] = solid;
+                m_opaque[maskRow(y, z)] = opaque;
+            }
+        }
+        else {
+            for (int z = 0; z < 16; ++z) {
+                const BlockType *row = &blocks[blockIndex(0, y, z)];
+                for (int x = 0; x < 16; ++x) {
+                    setBit(maskRow(y, z), x + 1, row[x]);
+                }
+            }
+        }
+        // The one-block border taken from our neighbors
+        for (int i = 0; i < 16; ++i) {
+            setBit(maskRow(y, i), 0, snapshot.m_borders[XNEG][i + 16 * y]);
+            setBit(maskRow(y, i), 17, snapshot.m_borders[XPOS][i + 16 * y]);
+            setBit(maskRow(y, -1), i + 1, snapshot.m_borders[ZNEG][i + 16 * y]);
+            setBit(maskRow(y, 16), i + 1, snapshot.m_borders[ZPOS][i + 16 * y]);
+        }
+    }
+
+    for (vector<uint16_t> &f : m_faces) {
+        f.assign(16 * 256, 0);
+    }
+    // A transparent block shows a face wherever it touches EMPTY, and an
+    // opaque block shows one wherever it touches anything transparent.
+    // Comparing each row against its neighbor in some direction
+    // (shifted by a bit for X, or the adjacent row for Y and Z)
+    // finds all 16 faces of the row in that direction at once.
+    // The loops over z have no dependencies between iterations
+    // so the compiler is free to vectorize them.
+    for (int y = 0; y < 256; ++y) {
+        for (int z = 0; z < 16; ++z) {
+            int r = maskRow(y, z);
+            uint32_t opaque = m_opaque[r];
+            uint32_t transparent = m_solid[r] & ~opaque;
+            auto visible = [opaque, transparent](uint32_t adjOpaque, uint32_t adjSolid) {
+                return static_cast<uint16_t>((((opaque & ~adjOpaque) | (transparent & ~adjSolid)) & ROW_INTERIOR) >> 1);
+            };
+            int i = z + 16 * y;
+            m_faces[XPOS][i] = visible(opaque >> 1, m_solid[r] >> 1);
+            m_faces[XNEG][i] = visible(opaque << 1, m_solid[r] << 1);
+            m_faces[YPOS][i] = visible(m_opaque[r + ROWS_PER_LAYER], m_solid[r + ROWS_PER_LAYER]);
+            m_faces[YNEG][i] = visible(m_opaque[r - ROWS_PER_LAYER], m_solid[r - ROWS_PER_LAYER]);
+            m_faces[ZPOS][i] = visible(m_opaque[r + 1], m_solid[r + 1]);
+            m_faces[ZNEG][i] = visible(m_opaque[r - 1], m_solid[r - 1]);
+        }
+    }
+}
+
+// The index of the lowest set bit of bits, which must not be 0
+static inline int lowestSetBit(uint32_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(bits);
+#endif
+}
+
+std::atomic<MeshingMode> VBOWorker::s_meshingMode(PER_FACE_MESHING);
+
+void VBOWorker::setMeshingMode(MeshingMode mode) {
+    s_meshingMode = mode;
+}
+
+MeshingMode VBOWorker::getMeshingMode() {
+    return s_meshingMode;
+}
+
+void VBOWorker::buildVBOData(ChunkVBOData &c) {
+    ChunkBlockSnapshot snapshot(c.mp_chunk, c.mp_neighbors);
+    ChunkFaceMasks masks(snapshot);
+    // The mesh spans the layers of blocks that show any face
+    auto layerHasFaces = [&masks](int y) {
+        for (const vector<uint16_t> &faces : masks.m_faces) {
+            for (int z = 0; z < 16; ++z) {
+                if (faces[z + 16 * y] != 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+    c.m_minY = 0;
+    while (c.m_minY < 256 && !layerHasFaces(c.m_minY)) {
+        c.m_minY++;
+    }
+    c.m_maxY = 255;
+    while (c.m_maxY >= c.m_minY && !layerHasFaces(c.m_maxY)) {
+        c.m_maxY--;
+    }
+    buildSectionVisibility(c, snapshot);
+    if (s_meshingMode == GREEDY_MESHING) {
+        buildGreedyVBOData(c, snapshot, masks);
+    }
+    else {
+        buildPerFaceVBOData(c, snapshot, masks);
+    }
+    // Every vertex also says which Chunk it belongs to
+    GLuint chunkBits = packChunkVertexChunk(c.mp_chunk->m_minX, c.mp_chunk->m_minZ);
+    for (vector<GLuint> *vbo : {&c.m_vboDataOpaque, &c.m_vboDataTransparent}) {
+        for (size_t i = 1; i < vbo->size(); i += CHUNK_VERTEX_WORDS) {
+            (*vbo)[i] |= chunkBits;
+        }
+    }
+}
+
+void VBOWorker::buildSectionVisibility(ChunkVBOData &c, const ChunkBlockSnapshot &snapshot) {
+    // Indexed by blockIndex() within the section
+    array<bool, SECTION_VOLUME> visited;
+    array<uint16_t, SECTION_VOLUME> stack;
+    for (int s = 0; s < 16; ++s) {
+        SectionVisibility &vis = c.m_sectionVisibility[s];
+        const BlockType *blocks = &snapshot.m_blocks[blockIndex(0, 16 * s, 0)];
+        if (snapshot.m_uniformSections[s]) {
+            // Either all air (or water), or all solid
+            vis = SectionVisibility();
+            if (!isTransparent(blocks[0])) {
+                vis.m_connected.fill(0);
+            }
+            continue;
+        }
+        vis.m_connected.fill(0);
+        visited.fill(false);
+        for (int start = 0; start < SECTION_VOLUME; ++start) {
+            if (visited[start] || !isTransparent(blocks[start])) {
+                continue;
+            }
+            // The faces this pocket of transparent blocks touches
+            uint8_t faces = 0;
+            int top = 0;
+            stack[top++] = static_cast<uint16_t>(start);
+            visited[start] = true;
+            while (top > 0) {
+                int cell = stack[--top];
+                ivec3 p(cell & 15, cell >> 8, (cell >> 4) & 15);
+                faces |= (p.x == 15) << XPOS | (p.x == 0) << XNEG |
+                         (p.y == 15) << YPOS | (p.y == 0) << YNEG |
+                         (p.z == 15) << ZPOS | (p.z == 0) << ZNEG;
+                for (const BlockFace &f : adjacentFaces) {
+                    ivec3 q = p + f.directionVec;
+                    if (q.x < 0 || q.x > 15 || q.y < 0 || q.y > 15 || q.z < 0 || q.z > 15) {
+                        continue;
+                    }
+                    int next = blockIndex(q.x, q.y, q.z);
+                    if (!visited[next] && isTransparent(blocks[next])) {
+                        visited[next] = true;
+                        stack[top++] = static_cast<uint16_t>(next);
+                    }
+                }
+            }
+            for (int f = 0; f < 6; ++f) {
+                if ((faces >> f) & 1) {
+                    vis.m_connected[f] |= faces;
+                }
+            }
+        }
+    }
+}
+
+void VBOWorker::buildPerFaceVBOData(ChunkVBOData &c, const ChunkBlockSnapshot &snapshot, const ChunkFaceMasks &masks) {
+    for (int y = 0; y < 256; ++y) {
+        for (int z = 0; z < 16; ++z) {
+            for (const BlockFace &f : adjacentFaces) {
+                // Visit each set bit, lowest first
+                for (uint32_t bits = masks.m_faces[f.direction][z + 16 * y]; bits != 0; bits &= bits - 1) {
+                    int x = lowestSetBit(bits);
+                    BlockType curr = snapshot.m_blocks[blockIndex(x, y, z)];
+                    if (isTransparent(curr)) {
+                        appendVBOData(c.m_vboDataTransparent, f, curr, ivec3(x,y,z), ivec3(1));
+                    }
+                    else {
+                        appendVBOData(c.m_vboDataOpaque, f, curr, ivec3(x,y,z), ivec3(1));
+                    }
+                }
+            }
+        }
+    }
+}
+
+void VBOWorker::buildGreedyVBOData(ChunkVBOData &c, const ChunkBlockSnapshot &snapshot, const ChunkFaceMasks &masks) {
+    const ivec3 dims(16, 256, 16);
+    // Distance between blockIndex()es of neighboring blocks along each axis
+    const ivec3 strides(1, 256, 16);
+    // The BlockType of each visible face in the current direction, or EMPTY,
+    // indexed by blockIndex(). Merging a face clears its entry, so this is
+    // all EMPTY again once each direction has been merged.
+    vector<BlockType> faces(65536, EMPTY);
+    vector<int> facesPerSlice(256);
+
+    for (const BlockFace &f : adjacentFaces) {
+        // n is the axis f faces along, and (u, v) are the two axes of its plane.
+        // Side faces use y as v so they can merge all the way up a cliff.
+        int n = f.directionVec.x != 0 ? 0 : (f.directionVec.y != 0 ? 1 : 2);
+        int u = n == 0 ? 2 : 0;
+        int v = n == 1 ? 2 : 1;
+        int dimU = dims[u], dimV = dims[v];
+        int strideU = strides[u], strideV = strides[v];
+
+        // Scatter the visible faces into faces[]
+        fill(facesPerSlice.begin(), facesPerSlice.end(), 0);
+        const vector<uint16_t> &rows = masks.m_faces[f.direction];
         for (int y = 0; y < 256; ++y) {
             for (int z = 0; z < 16; ++z) {
-                BlockType curr = mp_chunk->getBlockAt(x, y, z);
-                if (curr != EMPTY) {
-                    for (const BlockFace &f : adjacentFaces) {
-                        BlockType adj;
-                        if (crossesBorder(glm::ivec3(x, y, z), f.directionVec)) {
-                            Chunk* neighbor = mp_chunk->m_neighbors[f.direction];
-                            if (neighbor == nullptr) {
-                                adj = EMPTY;
-                            }
-                            else {
-                                int dx = (x + f.directionVec.x) % 16;
-                                if (dx < 0) dx = 16 + dx;
-                                int dy = (y + f.directionVec.y) % 256;
-                                if (dy < 0) dy = 256 + dy;
-                                int dz = (z + f.directionVec.z) % 16;
-                                if (dz < 0) dz = 16 + dz;
-                                adj = neighbor->getBlockAt(dx, dy, dz);
-                            }
-                        }
-                        else {
-                            adj = mp_chunk->getBlockAt(x + f.directionVec.x, y + f.directionVec.y, z + f.directionVec.z);
+                for (uint32_t bits = rows[z + 16 * y]; bits != 0; bits &= bits - 1) {
+                    int x = lowestSetBit(bits);
+                    unsigned int i = blockIndex(x, y, z);
+                    faces[i] = snapshot.m_blocks[i];
+                    facesPerSlice[n == 0 ? x : (n == 1 ? y : z)]++;
+                }
+            }
+        }
+
+        for (int slice = 0; slice < dims[n]; ++slice) {
+            if (facesPerSlice[slice] == 0) {
+                continue;
+            }
+            int base = slice * strides[n];
+            // Cover the visible faces with as few rectangles as we can by
+            // growing each one as far as possible along u, then along v
+            for (int j = 0; j < dimV; ++j) {
+                for (int i = 0; i < dimU; ) {
+                    int start = base + i * strideU + j * strideV;
+                    BlockType curr = faces[start];
+                    if (curr == EMPTY) {
+                        ++i;
+                        continue;
+                    }
+                    // lambert.vert.glsl makes waves by moving each vertex of
+                    // WATER, so a merged water quad would only move at its
+                    // corners and crack where it meets smaller quads. Faces
+                    // of transparent blocks (only WATER) are never merged.
+                    int w = 1, h = 1;
+                    if (!isTransparent(curr)) {
+                        while (i + w < dimU && faces[start + w * strideU] == curr) {
+                            ++w;
                         }
-                        // If the block we're creating faces for is transparent
-                        if (isTransparent(curr)) {
-                            if (adj == EMPTY) {
-                                appendVBOData(c.m_vboDataTransparent, c.m_idxDataTransparent, f, curr, ivec3(x,y,z), maxIdxOpq);
+                        for (; j + h < dimV; ++h) {
+                            bool rowMatches = true;
+                            for (int k = 0; k < w; ++k) {
+                                if (faces[start + k * strideU + h * strideV] != curr) {
+                                    rowMatches = false;
+                                    break;
+                                }
                             }
-                        }
-                        // If the block we're creating faces for is opaque
-                        else {
-                            if (isTransparent(adj)) {
-                                appendVBOData(c.m_vboDataOpaque, c.m_idxDataOpaque, f, curr, ivec3(x,y,z), maxIdxTra);
+                            if (!rowMatches) {
+                                break;
                             }
                         }
                     }
+                    for (int dj = 0; dj < h; ++dj) {
+                        for (int di = 0; di < w; ++di) {
+                            faces[start + di * strideU + dj * strideV] = EMPTY;
+                        }
+                    }
+
+                    ivec3 origin, extent(1);
+                    origin[n] = slice;
+                    origin[u] = i;
+                    origin[v] = j;
+                    extent[u] = w;
+                    extent[v] = h;
+                    if (isTransparent(curr)) {
+                        appendVBOData(c.m_vboDataTransparent, f, curr, origin, extent);
+                    }
+                    else {
+                        appendVBOData(c.m_vboDataOpaque, f, curr, origin, extent);
+                    }
+                    i += w;
                 }
             }
         }
     }
+}
+
+void VBOWorker::run() {
+    ChunkVBOData c(mp_chunk, m_neighbors, mp_token, m_meshGeneration);
+    // Terrain will throw the result away, but still needs
+    // it to know that we are done with our Chunks
+    if (!mp_token->isCancelled()) {
+        buildVBOData(c);
+    }
     mp_chunkVBOsCompletedLock->lock();
-    mp_chunkVBOsCompleted->push_back(c);
+    mp_chunkVBOsCompleted->push_back(std::move(c));
     mp_chunkVBOsCompletedLock->unlock();
 }
+
+ZoneLoadWorker::ZoneLoadWorker(int x, int z, const WorldNoise &noise, ZoneFieldCache *fieldCache,
+                               const string &path, std::vector<Chunk*> chunksToFill,
+                               std::unordered_set<Chunk*>* chunksCompleted, QMutex* chunksCompletedLock)
+    : m_xCorner(x), m_zCorner(z), m_noise(noise), mp_fieldCache(fieldCache), m_path(path), m_chunksToFill(chunksToFill),
+      mp_chunksCompleted(chunksCompleted), mp_chunksCompletedLock(chunksCompletedLock)
+{}
+
+bool ZoneLoadWorker::writeZone(const string &path, const vector<Chunk*> &chunks) {
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) {
+        return false;
+    }
+    uint32_t magic = ZONE_CACHE_MAGIC;
+    out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    for (const Chunk *c : chunks) {
+        c->writeBlocks(out);
+    }
+    return static_cast<bool>(out);
+}
+
+bool ZoneLoadWorker::readZone(const string &path, const vector<Chunk*> &chunks) {
+    ifstream in(path, ios::binary);
+    uint32_t magic = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    if (!in || magic != ZONE_CACHE_MAGIC) {
+        return false;
+    }
+    for (Chunk *c : chunks) {
+        if (!c->readBlocks(in)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ZoneLoadWorker::run() {
+    if (!readZone(m_path, m_chunksToFill)) {
+        // The cached copy is missing or damaged, so fall back
+        // to generating the zone from scratch. FBMWorker
+        // reports the Chunks as completed itself.
+        std::cout << "Could not load terrain zone from " << m_path << ", regenerating it" << std::endl;
+        for (Chunk *c : m_chunksToFill) {
+            FBMWorker(c, m_noise, mp_fieldCache, mp_chunksCompleted, mp_chunksCompletedLock).run();
+        }
+        return;
+    }
+    std::remove(m_path.c_str());
+    mp_chunksCompletedLock->lock();
+    for (Chunk *c : m_chunksToFill) {
+        mp_chunksCompleted->insert(c);
+    }
+    mp_chunksCompletedLock->unlock();
+}
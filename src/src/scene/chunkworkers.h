@@ -1,42 +1,324 @@
 #pragma once
 #include "noise_functions.h"
 #include "chunk.h"
+#include "terrainjobs.h"
 #include <QRunnable>
 #include <QMutex>
 #include <unordered_set>
+#include <atomic>
 
 enum Biome {
     GRASSLAND, MOUNTAIN, DESERT, ISLAND
 };
 
+// How VBOWorker turns a Chunk's visible block faces into quads
+enum MeshingMode {
+    // One quad per visible block face. The default.
+    PER_FACE_MESHING,
+    // Coplanar visible faces of the same opaque BlockType are
+    // merged into maximal rectangles, each drawn as a single quad.
+    // Far fewer vertices, but draws different triangles than
+    // PER_FACE_MESHING, so frames may not match it exactly.
+    GREEDY_MESHING
+};
+
+// How FBMWorker evaluates the 2D noise fields (the biome
+// value and the four biome heights) of a terrain zone
+enum HeightSamplingMode {
+    // Every column is evaluated. The default.
+    FULL_HEIGHT_SAMPLING,
+    // The fields are evaluated every ZONE_LATTICE_SPACING blocks and
+    // bilinearly interpolated in between, except in lattice cells
+    // where interpolation strays too far (see ZoneColumnFields).
+    // Faster, but moves the surface of some columns by a block or
+    // so, so worlds differ from those made with FULL_HEIGHT_SAMPLING.
+    COARSE_HEIGHT_SAMPLING
+};
+
+// How FBMWorker evaluates the 3D noise that decides whether
+// each block of a dirtStoneMix run (see BlockRun) is DIRT or STONE
+enum MaterialSamplingMode {
+    // Every block is evaluated. The default.
+    FULL_MATERIAL_SAMPLING,
+    // The noise is evaluated every MATERIAL_LATTICE_SPACING blocks
+    // and trilinearly interpolated in between (see DirtStoneMixVolume).
+    // Faster, but turns a few percent of DIRT blocks to STONE and
+    // back, so worlds differ from those made with FULL_MATERIAL_SAMPLING.
+    COARSE_MATERIAL_SAMPLING
+};
+
+// Spacing, in blocks, of the lattice used by COARSE_HEIGHT_SAMPLING.
+// Each lattice cell holds exactly one NOISE_BATCH_SIZE batch of columns.
+#define ZONE_LATTICE_SPACING 4
+// Largest difference allowed between a lattice cell's interpolated
+// and true value at its center and edge midpoints, in blocks for the
+// heights and in biomeValue() units for the biome. The biome tolerance
+// is tighter since biome weights multiply differences of up to ~100
+// blocks. The desert's noise is interpolated rather than its height,
+// and its height changes by up to ~100 blocks per unit of noise.
+#define ZONE_LATTICE_HEIGHT_TOLERANCE 0.5f
+#define ZONE_LATTICE_BIOME_TOLERANCE 0.005f
+#define ZONE_LATTICE_DESERT_NOISE_TOLERANCE 0.005f
+// Spacing, in blocks, of the lattice used by COARSE_MATERIAL_SAMPLING.
+// Must divide 16. The noise is sampled at pos / 8, so each of its
+// cells spans two lattice cells along each axis.
+#define MATERIAL_LATTICE_SPACING 4
+
+// The biome heights at one column of terrain, and how they blend
+struct BiomeHeights {
+    // biomeValue() remapped to [0, 1] and smoothstepped. Low y is
+    // desert/island, high y is grassland/mountain. Low x is
+    // desert/grassland, high x is island/mountain. Since the
+    // smoothstep saturates, most columns lie entirely in one biome.
+    vec2 m_blend;
+    // Each biome's height, indexed by Biome. Only those for which
+    // needsHeight() is true are evaluated, the rest are left at 0.
+    array<float, 4> m_heights;
+
+    // biome is the column's biomeValue()
+    BiomeHeights(vec2 biome);
+    // Whether b's height is used, either by blendedHeight() or by the
+    // block rules of the column's biome (GRASSLAND consults DESERT's)
+    bool needsHeight(Biome b) const;
+    // The column's terrain height
+    float blendedHeight() const;
+};
+
+// The 2D noise fields FBMWorker needs for every column of one terrain zone
+struct ZoneColumnFields {
+    // biomeValue(p / 750) of every column, indexed by columnIndex()
+    vector<vec2> m_biome;
+    // Every biome's height at every column, indexed by Biome and then
+    // by columnIndex(). Heights a column doesn't need are left at 0.
+    array<vector<float>, 4> m_heights;
+    // Every column's terrain height, BiomeHeights::blendedHeight()
+    // clamped to [0, 255], indexed by columnIndex()
+    vector<float> m_surfaceHeight;
+    // Lattice cells that COARSE_HEIGHT_SAMPLING had to evaluate
+    // at every column, for the biome and for each biome's height
+    int m_refinedBiomeCells;
+    array<int, 4> m_refinedHeightCells;
+
+    ZoneColumnFields(int xCorner, int zCorner, HeightSamplingMode mode);
+
+    // x and z are zone-local, in [0, 64)
+    static int columnIndex(int x, int z) {
+        return x + 64 * z;
+    }
+    BiomeHeights column(int index) const;
+};
 
+// A vertical run of blocks in one column, from y0 up to but not
+// including y1. If dirtStoneMix is set, type is ignored and each
+// block is DIRT or STONE depending on 3D noise at its position.
+struct BlockRun {
+    BlockType type;
+    int y0, y1;
+    bool dirtStoneMix;
+};
+
+// The runs making up one column of terrain, bottom to top.
+// No biome's rules need more than 8.
+struct ColumnRuns {
+    array<BlockRun, 8> m_runs;
+    int m_count;
+
+    ColumnRuns();
+    // Appends a run of t from the end of the last run up to (but not
+    // including) y1, unless that is empty. Never extends past top.
+    void extend(BlockType t, int y1, int top, bool dirtStoneMix = false);
+    // Where the last run ends
+    int end() const;
+};
+
+// The 3D noise behind dirtStoneMix runs, over the 16 x 256 x 16
+// block volume of a Chunk. Since that noise is sampled at chunk-local
+// positions, one volume serves every Chunk of a world, and
+// ZoneFieldCache keeps one for all of the world's FBMWorkers.
+// Under COARSE_MATERIAL_SAMPLING the whole lattice is evaluated
+// up front, so at() may be called from any number of threads.
+struct DirtStoneMixVolume {
+    MaterialSamplingMode m_mode;
+    // The noise at every lattice point, layer by layer along y.
+    // Each layer is laid out as latticeIndex() describes.
+    vector<float> m_lattice;
+
+    // Evaluates the lattice with the calling thread's WorldNoise
+    DirtStoneMixVolume(MaterialSamplingMode mode);
+
+    // pos is chunk-local
+    BlockType at(ivec3 pos) const;
+
+    // i, j and k are lattice coords along x, y and z
+    static int latticeIndex(int i, int j, int k) {
+        const int side = 16 / MATERIAL_LATTICE_SPACING + 1;
+        return i + side * (k + side * j);
+    }
+};
+
+class ZoneFieldCache;
+
+// Fills one Chunk with blocks. Terrain spawns one per Chunk rather
+// than one per terrain zone, so a zone's Chunks are generated in
+// parallel and each is reported as soon as it is filled. The zone's
+// 2D noise fields are still evaluated only once, by whichever of
+// its workers asks the ZoneFieldCache for them first.
 class FBMWorker : public QRunnable {
 private:
-    // Coords of the terrain zone being generated
+    static std::atomic<HeightSamplingMode> s_heightSamplingMode;
+    static std::atomic<MaterialSamplingMode> s_materialSamplingMode;
+
+    // Coords of the terrain zone mp_chunk belongs to
     int m_xCorner, m_zCorner;
-    std::vector<Chunk*> m_chunksToFill;
+    // The world being generated
+    WorldNoise m_noise;
+    // Holds the 2D noise fields of the world's zones, including ours
+    ZoneFieldCache *mp_fieldCache;
+    Chunk* mp_chunk;
     std::unordered_set<Chunk*>* mp_chunksCompleted;
     QMutex *mp_chunksCompletedLock;
 
+    // So it can undo spawnFBMWorker() if this worker never runs
+    friend class Terrain;
+
+    // Biome b's height at world-space column (x, z)
+    float biomeHeightAt(int x, int z, Biome b) const;
+
 public:
-    FBMWorker(int x, int z, std::vector<Chunk*> chunksToFill,
+    // fieldCache must be for the same world as noise
+    FBMWorker(Chunk *chunkToFill, const WorldNoise &noise, ZoneFieldCache *fieldCache,
               std::unordered_set<Chunk*>* chunksCompleted, QMutex* chunksCompletedLock);
     void run() override;
     Biome biomeMap(glm::vec2 val) const;
-    BlockType positionToBlockType(ivec3 pos, int maxHeight, Biome b, const unordered_map<Biome, float, EnumHash> &individualBiomeHeights) const;
+    // The runs of blocks of a column of biome b whose terrain is height
+    // blocks tall, before the water table is added. Every block of
+    // the column below height is filled.
+    ColumnRuns columnRuns(float height, Biome b, const BiomeHeights &individualBiomeHeights) const;
+    // The block of a dirtStoneMix run at chunk-local position pos,
+    // evaluating the noise exactly (see DirtStoneMixVolume)
+    static BlockType dirtStoneMixAt(ivec3 pos);
+    // Central differences of biome b's height at world-space
+    // column (pos.x, pos.z). Only DESERT has a slope so far.
     vec2 computeBiomeSlope(ivec3 pos, Biome b) const;
+
+    // Applies to every FBMWorker run afterwards
+    static void setHeightSamplingMode(HeightSamplingMode mode);
+    static HeightSamplingMode getHeightSamplingMode();
+    static void setMaterialSamplingMode(MaterialSamplingMode mode);
+    static MaterialSamplingMode getMaterialSamplingMode();
 };
 
 bool isTransparent(BlockType t);
 
+// A copy of a Chunk's blocks plus the single layer of blocks
+// bordering it in each of its four horizontal neighbors,
+// decoded out of palette storage in bulk so that meshing
+// can read any block it needs without locking or unpacking.
+struct ChunkBlockSnapshot {
+    // Every block of the Chunk, laid out as described by blockIndex()
+    vector<BlockType> m_blocks;
+    // The bordering slab of each neighbor, indexed by Direction
+    // (only XPOS, XNEG, ZPOS and ZNEG are used). Laid out as
+    // described by Chunk::decodeBorder. Missing neighbors are
+    // treated as EMPTY.
+    array<vector<BlockType>, 6> m_borders;
+    // Which of the Chunk's sections are a single block type
+    array<bool, 16> m_uniformSections;
+
+    // neighbors are c's neighbors indexed by Direction, as captured
+    // when the snapshot was requested rather than read from c, since
+    // Terrain may relink c's neighbors while we are running
+    ChunkBlockSnapshot(const Chunk *c, const array<Chunk*, 6> &neighbors);
+};
+
+// Which block faces of a Chunk are visible, found with bitwise
+// operations on whole rows of 16 blocks at a time rather than
+// by looking up each block's six neighbors one at a time.
+struct ChunkFaceMasks {
+    // One bit per block for each row of blocks along x, including
+    // the one-block border (so x and z in [-1, 16], y in [-1, 256]).
+    // m_solid marks any block that is not EMPTY, m_opaque any
+    // block that is not transparent.
+    vector<uint32_t> m_solid, m_opaque;
+    // Indexed by Direction, then by (z + 16 * y). Bit x is
+    // set if block (x, y, z) shows its face in that direction.
+    array<vector<uint16_t>, 6> m_faces;
+
+    ChunkFaceMasks(const ChunkBlockSnapshot &snapshot);
+};
+
 class VBOWorker : public QRunnable {
 private:
+    static std::atomic<MeshingMode> s_meshingMode;
+
     Chunk* mp_chunk;
+    // mp_chunk's neighbors when this worker was spawned
+    array<Chunk*, 6> m_neighbors;
+    // Cancelled when mp_chunk's zone leaves TERRAIN_CREATE_RADIUS
+    sPtr<TerrainJobToken> mp_token;
     vector<ChunkVBOData>* mp_chunkVBOsCompleted;
     QMutex *mp_chunkVBOsCompletedLock;
+    // mp_chunk's m_meshGeneration for the mesh we build
+    uint64_t m_meshGeneration;
+
+    // So it can undo spawnVBOWorker() if this worker never runs
+    friend class Terrain;
+
+public:
+    // Must be made on the main thread, as it starts a new
+    // mesh generation of c
+    VBOWorker(Chunk* c, const sPtr<TerrainJobToken> &token,
+              vector<ChunkVBOData>* dat, QMutex *datLock);
+    void run() override;
+    // Fills in the VBO data of d.mp_chunk. Used by run(), and
+    // by Chunk::create() to remesh a Chunk on the main thread.
+    static void buildVBOData(ChunkVBOData &d);
+    // The two halves of buildVBOData, one per MeshingMode
+    static void buildPerFaceVBOData(ChunkVBOData &d, const ChunkBlockSnapshot &snapshot, const ChunkFaceMasks &masks);
+    static void buildGreedyVBOData(ChunkVBOData &d, const ChunkBlockSnapshot &snapshot, const ChunkFaceMasks &masks);
+    // Fills in d.m_sectionVisibility by flood filling the
+    // transparent blocks of each section that isn't uniform
+    static void buildSectionVisibility(ChunkVBOData &d, const ChunkBlockSnapshot &snapshot);
+    // Appends one quad for face f of the box of blocks starting at xyz
+    // and spanning extent blocks along each axis (1 along f's normal)
+    static void appendVBOData(vector<GLuint> &vbo, const BlockFace &f, BlockType curr,
+                              ivec3 xyz, ivec3 extent);
+
+    // Applies to every VBOWorker and Chunk::create() call made afterwards
+    static void setMeshingMode(MeshingMode mode);
+    static MeshingMode getMeshingMode();
+};
+
+// Identifies a terrain zone written by ZoneLoadWorker::writeZone
+#define ZONE_CACHE_MAGIC 0x315a4d4d
+
+// Fills the Chunks of a terrain zone that Terrain evicted
+// earlier by reading back the blocks it wrote to disk,
+// instead of generating them again with an FBMWorker.
+// Reports the filled Chunks exactly as an FBMWorker would.
+class ZoneLoadWorker : public QRunnable {
+private:
+    // Coords of the terrain zone being loaded
+    int m_xCorner, m_zCorner;
+    // Used to regenerate the zone if it can't be read
+    WorldNoise m_noise;
+    ZoneFieldCache *mp_fieldCache;
+    string m_path;
+    std::vector<Chunk*> m_chunksToFill;
+    std::unordered_set<Chunk*>* mp_chunksCompleted;
+    QMutex *mp_chunksCompletedLock;
+
+    // So it can undo spawnFBMWorker() if this worker never runs
+    friend class Terrain;
 
 public:
-    VBOWorker(Chunk* c, vector<ChunkVBOData>* dat, QMutex *datLock);
+    ZoneLoadWorker(int x, int z, const WorldNoise &noise, ZoneFieldCache *fieldCache,
+                   const string &path, std::vector<Chunk*> chunksToFill,
+                   std::unordered_set<Chunk*>* chunksCompleted, QMutex* chunksCompletedLock);
     void run() override;
-    static void appendVBOData(vector<float> &vbo, vector<GLuint> &idx, const BlockFace &f, BlockType curr, ivec3 xyz, unsigned int &maxIdx);
+
+    // Write and read the blocks of a zone's 16 Chunks, in the order
+    // Terrain::spawnFBMWorker lists them. Return false on any I/O error.
+    static bool writeZone(const string &path, const vector<Chunk*> &chunks);
+    static bool readZone(const string &path, const vector<Chunk*> &chunks);
 };
@@ -159,14 +159,14 @@ void Cube::create()
     // The next few sets of function calls are basically the same as above, except bufPos and bufNor are
     // array buffers rather than element array buffers, as they store vertex attributes like position.
     generatePos();
-    context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
+    context->bindArrayBuffer(bufPos);
     context->glBufferData(GL_ARRAY_BUFFER, CUB_VERT_COUNT * sizeof(glm::vec4), sph_vert_pos, GL_STATIC_DRAW);
 
     generateNor();
-    context->glBindBuffer(GL_ARRAY_BUFFER, bufNor);
+    context->bindArrayBuffer(bufNor);
     context->glBufferData(GL_ARRAY_BUFFER, CUB_VERT_COUNT * sizeof(glm::vec4), sph_vert_nor, GL_STATIC_DRAW);
 
     generateCol();
-    context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
+    context->bindArrayBuffer(bufCol);
     context->glBufferData(GL_ARRAY_BUFFER, CUB_VERT_COUNT * sizeof(glm::vec4), cub_vert_col, GL_STATIC_DRAW);
 }
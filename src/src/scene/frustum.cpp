@@ -0,0 +1,31 @@
+#include "frustum.h"
+
+Frustum::Frustum(const glm::mat4 &viewProj)
+    : m_planes()
+{
+    // Each plane is the sum or difference of the matrix's last row
+    // and one of its first three (glm matrices are column-major)
+    auto row = [&viewProj](int i) {
+        return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    };
+    for (int i = 0; i < 3; ++i) {
+        m_planes[2 * i] = row(3) + row(i);
+        m_planes[2 * i + 1] = row(3) - row(i);
+    }
+    for (glm::vec4 &plane : m_planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersectsBox(glm::vec3 min, glm::vec3 max) const {
+    for (const glm::vec4 &plane : m_planes) {
+        // The corner of the box furthest along the plane's normal
+        glm::vec3 p(plane.x >= 0.f ? max.x : min.x,
+                    plane.y >= 0.f ? max.y : min.y,
+                    plane.z >= 0.f ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), p) + plane.w < 0.f) {
+            return false;
+        }
+    }
+    return true;
+}
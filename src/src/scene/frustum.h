@@ -0,0 +1,22 @@
+#pragma once
+#include "glm_includes.h"
+#include <array>
+
+// The six planes bounding what a camera can see, extracted from
+// its view-projection matrix, for culling whole Chunks before
+// they are drawn.
+class Frustum {
+private:
+    // Left, right, bottom, top, near and far, in world space.
+    // xyz is each plane's normal, pointing into the frustum,
+    // and a point p is on the inside if dot(xyz, p) + w >= 0.
+    std::array<glm::vec4, 6> m_planes;
+
+public:
+    Frustum(const glm::mat4 &viewProj);
+
+    // Does any part of the axis-aligned box from min to max lie
+    // inside the frustum? Conservative: a box near a corner of the
+    // frustum may be reported as inside even though it isn't.
+    bool intersectsBox(glm::vec3 min, glm::vec3 max) const;
+};
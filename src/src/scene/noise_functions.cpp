@@ -1,42 +1,65 @@
 #include "noise_functions.h"
 #include <iostream>
+#include <climits>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOISE_BATCH_SSE2
+#endif
 
 float step(float e, float x) {
     return x < e ? 0.f : 1.f;
 }
 
-float desertValue(vec2 uv) {
-    uv = uv / 256.f;
-    float x = fractalPerlin(uv, 4);
+// The parts of desertValue(), mountainValue(), grasslandValue() and
+// islandValue() that run after their noise functions, shared with
+// the batch versions of those functions below
+float desertTerraceHeight(float x) {
     float height = glm::max(0.05f * (1.0f - glm::pow(4.0f * (x - 0.42f), 2.0f)), 0.0f)+ glm::smoothstep(0.05f, 0.2f, x) * (glm::max(((0.4f-x*x) * 0.2f), 0.0f) + (step(x, 0.69f) + step(0.69f, x) * (glm::abs(glm::mod(glm::floor(x * 100.0f), 2.0f)) * 0.1f + 0.9f) * step(x, 0.8f) + 1.0f - step(x, 0.8f)) * ((glm::pow(glm::smoothstep(0.0f, 0.9f, pow(glm::smoothstep(0.0f, 1.0f, x), 1.0f)), 100.0f) + x * 0.1f) / 1.1f));
     return (1.f - height) * 50.f + 133.f;
 }
 
-float mountainValue(vec2 uv) {
-    float perlin = mountainSummedPerlin(uv / 128.f, 6);
+static float mountainHeight(float perlin) {
     return glm::pow(perlin, 3.f) * 105.f + 150.f;
 }
 
-float grasslandValue(vec2 uv) {
-    uv = uv / 256.f;
-    float cellHeight = 1.f;
-    float worley = worleyNoise2Point(uv * 4.f, &cellHeight);
+static float grasslandHeight(float worley, float cellHeight, float fbmNoise) {
     worley = max(0.f, worley - 0.1f);
     worley = smoothStep(0, 1, worley);
     worley = cellHeight * worley;
+    return (worley * 0.33f + fbmNoise * 0.67f) * 32.f + 110.f;
+}
 
-    float fbmNoise = fractalPerlin(uv, 8);
+static float islandHeight(float worley, float fbmNoise) {
+    float noise = 0.67f * worley + fbmNoise * 0.33f;
+    return smoothstep(0.f, 1.f, noise) * 45.f + 100.f;
+    //return smoothstep(0.f, 1.f, fbm(uv, 4)) * 50.f + 90.f;
+}
 
-    return (worley * 0.33f + fbmNoise * 0.67f) * 32.f + 110.f;
+float desertValue(vec2 uv) {
+    uv = uv / 256.f;
+    return desertTerraceHeight(fractalPerlin(uv, 4));
+}
+
+float mountainValue(vec2 uv) {
+    return mountainHeight(mountainSummedPerlin(uv / 128.f, 6));
+}
+
+float grasslandValue(vec2 uv) {
+    uv = uv / 256.f;
+    float cellHeight = 1.f;
+    float worley = worleyNoise2Point(uv * 4.f, &cellHeight);
+    return grasslandHeight(worley, cellHeight, fractalPerlin(uv, 8));
 }
 
 float islandValue(vec2 uv) {
     uv = uv / 128.f;
-    float cellHeight;
-    float noise = worleyNoise2Point(uv + vec2(128, 256), &cellHeight);
-    noise = 0.67f * noise + fbm(uv, 4) * 0.33f;
-    return smoothstep(0.f, 1.f, noise) * 45.f + 100.f;
-    //return smoothstep(0.f, 1.f, fbm(uv, 4)) * 50.f + 90.f;
+    float cellHeight = 1.f;
+    float worley = worleyNoise2Point(uv + vec2(128, 256), &cellHeight);
+    return islandHeight(worley, fbm(uv, 4));
 }
 
 vec2 biomeValue(vec2 uv) {
@@ -60,26 +83,96 @@ float combinedNoise(vec2 uv) {
     return worley * 0.33f + fbmNoise * 0.67f;
 }
 
+static thread_local WorldNoise t_worldNoise;
+
+WorldNoiseScope::WorldNoiseScope(const WorldNoise &noise)
+    : m_previous(t_worldNoise)
+{
+    t_worldNoise = noise;
+}
+
+WorldNoiseScope::~WorldNoiseScope() {
+    t_worldNoise = m_previous;
+}
+
+// Each random function hashes with its own salt,
+// so their values are unrelated to each other
+#define SALT_RANDOM2 0x243f6a8885a308d3ull
+#define SALT_RANDOM2_3D 0x13198a2e03707344ull
+#define SALT_RANDOM3 0xa4093822299f31d0ull
+#define SALT_RANDOM2B 0x082efa98ec4e6c89ull
+#define SALT_RANDOM1 0x452821e638d01377ull
+
+// The splitmix64 finalizer
+static uint64_t mixBits(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+}
+
+static uint64_t floatBits(float f) {
+    // Adding zero turns -0 into +0, so both hash the same
+    f += 0.f;
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+// 64 well mixed bits from a point, a salt and the world's seed
+static uint64_t hashPoint(uint64_t salt, float x, float y, float z = 0.f) {
+    uint64_t h = mixBits(t_worldNoise.seed ^ salt);
+    h = mixBits(h ^ floatBits(x));
+    h = mixBits(h ^ (floatBits(y) << 32 | floatBits(z)));
+    return h;
+}
+
+// The 24 bits of h starting at bit 40 - 24 * i, as a float in [0, 1)
+static float unitFloat(uint64_t h, int i) {
+    return static_cast<float>((h >> (40 - 24 * i)) & 0xffffff) / 16777216.f;
+}
+
 vec2 random2(vec2 p) {
+    if (t_worldNoise.backend == INTEGER_HASH_NOISE) {
+        uint64_t h = hashPoint(SALT_RANDOM2, p.x, p.y);
+        return vec2(unitFloat(h, 0), unitFloat(h, 1));
+    }
     return fract(sin(vec2(dot(p, vec2(127.1f, 311.7f)),dot(p, vec2(269.5f, 183.3f)))) * 43758.5453f);
 }
 
 vec2 random2(vec3 p) {
+    if (t_worldNoise.backend == INTEGER_HASH_NOISE) {
+        uint64_t h = hashPoint(SALT_RANDOM2_3D, p.x, p.y, p.z);
+        return vec2(unitFloat(h, 0), unitFloat(h, 1));
+    }
     return fract(sin(vec2(dot(p, vec3(127.1f, 311.7f, 420.69f)),
                           dot(p, vec3(269.5f, 183.3f, 632.897f)))) * 43758.5453f);
 }
 
 vec3 random3(vec3 p) {
+    if (t_worldNoise.backend == INTEGER_HASH_NOISE) {
+        uint64_t h = hashPoint(SALT_RANDOM3, p.x, p.y, p.z);
+        return vec3(unitFloat(h, 0), unitFloat(h, 1), unitFloat(mixBits(h), 0));
+    }
     return fract(sin(vec3(dot(p, vec3(127.1f, 311.7f, 420.69f)),
                           dot(p, vec3(269.5f, 183.3f, 632.897f)),
                           dot(p - vec3(5.555, 10.95645, 70.266), vec3(765.54f, 631.2f, 109.21f)))) * 43758.5453f);
 }
 
 vec2 random2b(vec2 p) {
+    if (t_worldNoise.backend == INTEGER_HASH_NOISE) {
+        uint64_t h = hashPoint(SALT_RANDOM2B, p.x, p.y);
+        return vec2(unitFloat(h, 0), unitFloat(h, 1));
+    }
     return fract(sin(vec2(dot(p,vec2(420.6f, 631.2f)),dot(p,vec2(652.123f,311.7f))))*43758.5453f);
 }
 
 float random1(vec2 p){
+    if (t_worldNoise.backend == INTEGER_HASH_NOISE) {
+        return unitFloat(hashPoint(SALT_RANDOM1, p.x, p.y), 0);
+    }
     return fract(sin(dot(p, vec2(420.6f, 631.2f)))*43758.5453f);
 }
 
@@ -238,3 +331,414 @@ float worleyNoise2Point(vec2 uv, float *cellHeight) {
     float finalOutput = -1 * minDist1 + minDist2;
     return finalOutput;
 }
+
+
+// Four floats operated on in lockstep. This is one SSE2 register
+// where available, and otherwise a plain array of four floats.
+// The two versions round identically, so batch results do not
+// depend on which one was compiled.
+struct NoiseLanes {
+#ifdef NOISE_BATCH_SSE2
+    __m128 v;
+
+    static NoiseLanes load(const float *p) {
+        return NoiseLanes{_mm_loadu_ps(p)};
+    }
+    static NoiseLanes splat(float f) {
+        return NoiseLanes{_mm_set1_ps(f)};
+    }
+    void store(float *p) const {
+        _mm_storeu_ps(p, v);
+    }
+    NoiseLanes operator+(NoiseLanes o) const {
+        return NoiseLanes{_mm_add_ps(v, o.v)};
+    }
+    NoiseLanes operator-(NoiseLanes o) const {
+        return NoiseLanes{_mm_sub_ps(v, o.v)};
+    }
+    NoiseLanes operator*(NoiseLanes o) const {
+        return NoiseLanes{_mm_mul_ps(v, o.v)};
+    }
+    NoiseLanes abs() const {
+        return NoiseLanes{_mm_andnot_ps(_mm_set1_ps(-0.f), v)};
+    }
+    static NoiseLanes min(NoiseLanes a, NoiseLanes b) {
+        return NoiseLanes{_mm_min_ps(a.v, b.v)};
+    }
+    // a < b ? ifLess : otherwise, per lane
+    static NoiseLanes selectLess(NoiseLanes a, NoiseLanes b, NoiseLanes ifLess, NoiseLanes otherwise) {
+        __m128 less = _mm_cmplt_ps(a.v, b.v);
+        return NoiseLanes{_mm_or_ps(_mm_and_ps(less, ifLess.v), _mm_andnot_ps(less, otherwise.v))};
+    }
+#else
+    float v[4];
+
+    static NoiseLanes load(const float *p) {
+        return NoiseLanes{{p[0], p[1], p[2], p[3]}};
+    }
+    static NoiseLanes splat(float f) {
+        return NoiseLanes{{f, f, f, f}};
+    }
+    void store(float *p) const {
+        for (int i = 0; i < 4; ++i) {
+            p[i] = v[i];
+        }
+    }
+    NoiseLanes operator+(NoiseLanes o) const {
+        return NoiseLanes{{v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3]}};
+    }
+    NoiseLanes operator-(NoiseLanes o) const {
+        return NoiseLanes{{v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2], v[3] - o.v[3]}};
+    }
+    NoiseLanes operator*(NoiseLanes o) const {
+        return NoiseLanes{{v[0] * o.v[0], v[1] * o.v[1], v[2] * o.v[2], v[3] * o.v[3]}};
+    }
+    NoiseLanes abs() const {
+        return NoiseLanes{{std::abs(v[0]), std::abs(v[1]), std::abs(v[2]), std::abs(v[3])}};
+    }
+    static NoiseLanes min(NoiseLanes a, NoiseLanes b) {
+        NoiseLanes r;
+        for (int i = 0; i < 4; ++i) {
+            r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+        }
+        return r;
+    }
+    static NoiseLanes selectLess(NoiseLanes a, NoiseLanes b, NoiseLanes ifLess, NoiseLanes otherwise) {
+        NoiseLanes r;
+        for (int i = 0; i < 4; ++i) {
+            r.v[i] = a.v[i] < b.v[i] ? ifLess.v[i] : otherwise.v[i];
+        }
+        return r;
+    }
+#endif
+};
+
+// Most lattice points a LatticeCache will tabulate
+#define LATTICE_CACHE_SIZE 192
+
+// The value of a hash function at every lattice point near a batch
+// of points. Neighboring points mostly share lattice points, so
+// tabulating them once replaces most of the sin() based hashing.
+// Covers floor(uv[i]) + [lo, hi] on both axes for every point.
+// If the batch is too spread out to tabulate, at() hashes directly.
+template <typename T>
+class LatticeCache {
+private:
+    T (*m_hash)(vec2);
+    ivec2 m_min;
+    int m_width;
+    bool m_tabulated;
+    T m_values[LATTICE_CACHE_SIZE];
+
+public:
+    LatticeCache(const vec2 *uv, int lo, int hi, T (*hash)(vec2))
+        : m_hash(hash), m_min(INT_MAX), m_width(0), m_tabulated(false)
+    {
+        ivec2 maxCell(INT_MIN);
+        for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+            ivec2 cell(glm::floor(uv[i]));
+            m_min = glm::min(m_min, cell);
+            maxCell = glm::max(maxCell, cell);
+        }
+        int64_t width = int64_t(maxCell.x) - m_min.x + hi - lo + 1;
+        int64_t height = int64_t(maxCell.y) - m_min.y + hi - lo + 1;
+        if (width * height > LATTICE_CACHE_SIZE) {
+            return;
+        }
+        m_min += ivec2(lo);
+        m_width = static_cast<int>(width);
+        m_tabulated = true;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < m_width; ++x) {
+                m_values[x + m_width * y] = m_hash(vec2(m_min + ivec2(x, y)));
+            }
+        }
+    }
+
+    // latticePoint must have integer coordinates
+    T at(vec2 latticePoint) const {
+        if (!m_tabulated) {
+            return m_hash(latticePoint);
+        }
+        ivec2 i = ivec2(latticePoint) - m_min;
+        return m_values[i.x + m_width * i.y];
+    }
+};
+
+// Four lanes of surflet(vec2, vec2), given P - gridPoint and the
+// gradient at gridPoint. Uses Horner's rule instead of pow().
+static NoiseLanes surflet4(NoiseLanes diffX, NoiseLanes diffY, NoiseLanes gradX, NoiseLanes gradY) {
+    NoiseLanes one = NoiseLanes::splat(1.f), six = NoiseLanes::splat(6.f),
+               fifteen = NoiseLanes::splat(15.f), ten = NoiseLanes::splat(10.f);
+    NoiseLanes distX = diffX.abs(), distY = diffY.abs();
+    NoiseLanes tX = one - distX * distX * distX * (distX * (distX * six - fifteen) + ten);
+    NoiseLanes tY = one - distY * distY * distY * (distY * (distY * six - fifteen) + ten);
+    NoiseLanes height = diffX * gradX + diffY * gradY;
+    return height * tX * tY;
+}
+
+void perlinNoiseBatch(const vec2 *uv, float *out) {
+    // The corners of each point's cell, in the order perlinNoise() sums them
+    static const vec2 corners[4] = {vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 1)};
+    LatticeCache<vec2> gradients(uv, 0, 1, random2);
+
+    float fractX[NOISE_BATCH_SIZE], fractY[NOISE_BATCH_SIZE];
+    float gradX[4][NOISE_BATCH_SIZE], gradY[4][NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        vec2 cell = floor(uv[i]);
+        fractX[i] = uv[i].x - cell.x;
+        fractY[i] = uv[i].y - cell.y;
+        for (int c = 0; c < 4; ++c) {
+            vec2 gradient = gradients.at(cell + corners[c]);
+            gradX[c][i] = gradient.x;
+            gradY[c][i] = gradient.y;
+        }
+    }
+    for (int i = 0; i < NOISE_BATCH_SIZE; i += 4) {
+        NoiseLanes x = NoiseLanes::load(fractX + i), y = NoiseLanes::load(fractY + i);
+        NoiseLanes sum = NoiseLanes::splat(0.f);
+        for (int c = 0; c < 4; ++c) {
+            sum = sum + surflet4(x - NoiseLanes::splat(corners[c].x), y - NoiseLanes::splat(corners[c].y),
+                                 NoiseLanes::load(gradX[c] + i), NoiseLanes::load(gradY[c] + i));
+        }
+        sum.store(out + i);
+    }
+}
+
+void fractalPerlinBatch(const vec2 *uv, int octaves, float *out) {
+    vec2 scaled[NOISE_BATCH_SIZE];
+    float noise[NOISE_BATCH_SIZE];
+    float amp = 0.5;
+    float freq = 4.0;
+    std::fill_n(out, NOISE_BATCH_SIZE, 0.f);
+    for (int o = 0; o < octaves; o++) {
+        for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+            scaled[i] = uv[i] * freq;
+        }
+        perlinNoiseBatch(scaled, noise);
+        for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+            out[i] += (1.f - abs(noise[i])) * amp;
+        }
+        amp *= 0.5;
+        freq *= 2.0;
+    }
+}
+
+void mountainSummedPerlinBatch(const vec2 *uv, int octaves, float *out) {
+    vec2 scaled[NOISE_BATCH_SIZE];
+    float noise[NOISE_BATCH_SIZE];
+    float prevValue[NOISE_BATCH_SIZE];
+    float amp = 0.5;
+    float freq = 1.0;
+    float maxSum = 0.0;
+    std::fill_n(out, NOISE_BATCH_SIZE, 0.f);
+    std::fill_n(prevValue, NOISE_BATCH_SIZE, 1.f);
+    for (int o = 0; o < octaves; ++o) {
+        maxSum += amp;
+        for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+            scaled[i] = uv[i] * freq;
+        }
+        perlinNoiseBatch(scaled, noise);
+        for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+            float n = (1.f - abs(noise[i])) * prevValue[i];
+            prevValue[i] = n;
+            out[i] += n * amp;
+        }
+        amp *= 0.5;
+        freq *= 2.0;
+    }
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        out[i] /= maxSum;
+    }
+}
+
+static void bilerpNoiseBatch(const vec2 *uv, float *out) {
+    static const vec2 corners[4] = {vec2(0, 0), vec2(1, 0), vec2(0, 1), vec2(1, 1)};
+    LatticeCache<float> values(uv, 0, 1, random1);
+
+    float fractX[NOISE_BATCH_SIZE], fractY[NOISE_BATCH_SIZE];
+    float corner[4][NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        vec2 cell = floor(uv[i]);
+        fractX[i] = uv[i].x - cell.x;
+        fractY[i] = uv[i].y - cell.y;
+        for (int c = 0; c < 4; ++c) {
+            corner[c][i] = values.at(cell + corners[c]);
+        }
+    }
+    // smoothStep(), four lanes at a time
+    NoiseLanes three = NoiseLanes::splat(3.f), two = NoiseLanes::splat(2.f);
+    auto smoothLerp = [&](NoiseLanes a, NoiseLanes b, NoiseLanes t) {
+        t = t * t * (three - two * t);
+        return a + t * (b - a);
+    };
+    for (int i = 0; i < NOISE_BATCH_SIZE; i += 4) {
+        NoiseLanes x = NoiseLanes::load(fractX + i), y = NoiseLanes::load(fractY + i);
+        NoiseLanes lerpXL = smoothLerp(NoiseLanes::load(corner[0] + i), NoiseLanes::load(corner[1] + i), x);
+        NoiseLanes lerpXU = smoothLerp(NoiseLanes::load(corner[2] + i), NoiseLanes::load(corner[3] + i), x);
+        smoothLerp(lerpXL, lerpXU, y).store(out + i);
+    }
+}
+
+void fbmBatch(const vec2 *uv, int octaves, float *out) {
+    vec2 scaled[NOISE_BATCH_SIZE];
+    float noise[NOISE_BATCH_SIZE];
+    float amp = 0.5;
+    float freq = 4.0;
+    std::fill_n(out, NOISE_BATCH_SIZE, 0.f);
+    for (int o = 0; o < octaves; o++) {
+        for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+            scaled[i] = uv[i] * freq;
+        }
+        bilerpNoiseBatch(scaled, noise);
+        for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+            out[i] += noise[i] * amp;
+        }
+        amp *= 0.5;
+        freq *= 2.0;
+    }
+}
+
+// The random point within a Worley cell, and the
+// cell height worleyNoise2Point() derives from it
+static vec3 worleyFeature(vec2 cell) {
+    vec2 point = random2(cell);
+    return vec3(point, random2(point).x);
+}
+
+void worleyNoise2PointBatch(const vec2 *uv, float *out, float *cellHeights) {
+    LatticeCache<vec3> features(uv, -1, 1, worleyFeature);
+
+    vec2 scaled[NOISE_BATCH_SIZE];
+    float angle[NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        scaled[i] = uv[i] * 2.f;
+    }
+    perlinNoiseBatch(scaled, angle);
+
+    vec2 cells[NOISE_BATCH_SIZE];
+    float fractX[NOISE_BATCH_SIZE], fractY[NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        cells[i] = floor(uv[i]);
+        vec2 uvFract = fract(uv[i]);
+        float a = angle[i] * 3.14159f;
+        uvFract += vec2(cos(a), sin(a)) * 0.25f;
+        fractX[i] = uvFract.x;
+        fractY[i] = uvFract.y;
+    }
+
+    for (int i = 0; i < NOISE_BATCH_SIZE; i += 4) {
+        NoiseLanes x = NoiseLanes::load(fractX + i), y = NoiseLanes::load(fractY + i);
+        NoiseLanes minDist1 = NoiseLanes::splat(1.f), minDist2 = NoiseLanes::splat(1.f);
+        NoiseLanes cellHeight = NoiseLanes::load(cellHeights + i);
+        for (int ny = -1; ny <= 1; ny++) {
+            for (int nx = -1; nx <= 1; nx++) {
+                vec2 neighbor = vec2(float(nx), float(ny));
+                float pointX[4], pointY[4], pointHeight[4];
+                for (int l = 0; l < 4; ++l) {
+                    vec3 feature = features.at(cells[i + l] + neighbor);
+                    pointX[l] = feature.x;
+                    pointY[l] = feature.y;
+                    pointHeight[l] = feature.z;
+                }
+                NoiseLanes diffX = NoiseLanes::splat(neighbor.x) + NoiseLanes::load(pointX) - x;
+                NoiseLanes diffY = NoiseLanes::splat(neighbor.y) + NoiseLanes::load(pointY) - y;
+                NoiseLanes dist = diffX * diffX + diffY * diffY;
+                // Same as the if / else if in worleyNoise2Point()
+                minDist2 = NoiseLanes::selectLess(dist, minDist1, minDist1, NoiseLanes::min(minDist2, dist));
+                cellHeight = NoiseLanes::selectLess(dist, minDist1, NoiseLanes::load(pointHeight), cellHeight);
+                minDist1 = NoiseLanes::selectLess(dist, minDist1, dist, minDist1);
+            }
+        }
+        NoiseLanes half = NoiseLanes::splat(0.5f);
+        (half * cellHeight + half).store(cellHeights + i);
+        (minDist2 - minDist1).store(out + i);
+    }
+}
+
+void biomeValueBatch(const vec2 *uv, vec2 *out) {
+    vec2 offset[NOISE_BATCH_SIZE];
+    float x[NOISE_BATCH_SIZE], y[NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        offset[i] = uv[i] + vec2(-1000, 1024);
+    }
+    perlinNoiseBatch(uv, x);
+    perlinNoiseBatch(offset, y);
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        out[i] = vec2(x[i], y[i]);
+    }
+}
+
+// Whether noise is close enough to one of desertTerraceHeight()'s
+// steps that the batch and single-point noise may straddle it
+static bool nearDesertTerraceStep(float noise) {
+    if (noise < DESERT_TERRACE_MIN - NOISE_BATCH_TOLERANCE || noise > DESERT_TERRACE_MAX + NOISE_BATCH_TOLERANCE) {
+        return false;
+    }
+    // Steps are where floor(100 * noise) changes
+    float scaled = 100.f * noise;
+    return glm::abs(scaled - glm::round(scaled)) <= 100.f * NOISE_BATCH_TOLERANCE;
+}
+
+void desertNoiseBatch(const vec2 *uv, float *out) {
+    vec2 scaled[NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        scaled[i] = uv[i] / 256.f;
+    }
+    fractalPerlinBatch(scaled, 4, out);
+    // Use the exact single-point noise next to a terrace step, so
+    // the column lands on the same side of it as desertValue()
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        if (nearDesertTerraceStep(out[i])) {
+            out[i] = fractalPerlin(scaled[i], 4);
+        }
+    }
+}
+
+void desertValueBatch(const vec2 *uv, float *out) {
+    desertNoiseBatch(uv, out);
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        out[i] = desertTerraceHeight(out[i]);
+    }
+}
+
+void mountainValueBatch(const vec2 *uv, float *out) {
+    vec2 scaled[NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        scaled[i] = uv[i] / 128.f;
+    }
+    mountainSummedPerlinBatch(scaled, 6, out);
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        out[i] = mountainHeight(out[i]);
+    }
+}
+
+void grasslandValueBatch(const vec2 *uv, float *out) {
+    vec2 scaled[NOISE_BATCH_SIZE], worleyUV[NOISE_BATCH_SIZE];
+    float worley[NOISE_BATCH_SIZE], cellHeight[NOISE_BATCH_SIZE], fbmNoise[NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        scaled[i] = uv[i] / 256.f;
+        worleyUV[i] = scaled[i] * 4.f;
+        cellHeight[i] = 1.f;
+    }
+    worleyNoise2PointBatch(worleyUV, worley, cellHeight);
+    fractalPerlinBatch(scaled, 8, fbmNoise);
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        out[i] = grasslandHeight(worley[i], cellHeight[i], fbmNoise[i]);
+    }
+}
+
+void islandValueBatch(const vec2 *uv, float *out) {
+    vec2 scaled[NOISE_BATCH_SIZE], worleyUV[NOISE_BATCH_SIZE];
+    float worley[NOISE_BATCH_SIZE], cellHeight[NOISE_BATCH_SIZE], fbmNoise[NOISE_BATCH_SIZE];
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        scaled[i] = uv[i] / 128.f;
+        worleyUV[i] = scaled[i] + vec2(128, 256);
+        cellHeight[i] = 1.f;
+    }
+    worleyNoise2PointBatch(worleyUV, worley, cellHeight);
+    fbmBatch(scaled, 4, fbmNoise);
+    for (int i = 0; i < NOISE_BATCH_SIZE; ++i) {
+        out[i] = islandHeight(worley[i], fbmNoise[i]);
+    }
+}
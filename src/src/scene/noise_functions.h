@@ -1,5 +1,6 @@
 #pragma once
 #include "glm_includes.h"
+#include <cstdint>
 
 #define DESERT_MAX_HEIGHT 128.f
 #define MOUNTAIN_MAX_HEIGHT 248.f
@@ -8,6 +9,41 @@
 
 using namespace glm;
 
+// Where the pseudo-random values behind every noise function
+// (random1, random2, random2b and random3) come from
+enum NoiseBackend {
+    // fract(sin(dot(p, k)) * 43758.5453), as in our shaders. Cheap on a
+    // GPU, but slow in C++, and the result depends on the platform's
+    // sin(). Has no seed, so every world it generates is the same.
+    SIN_HASH_NOISE,
+    // A 64-bit integer hash of the point's coordinates and the seed.
+    // Gives the same values on every platform and compiler.
+    INTEGER_HASH_NOISE
+};
+
+// The noise settings of one world
+struct WorldNoise {
+    NoiseBackend backend;
+    // Only used by INTEGER_HASH_NOISE
+    uint64_t seed;
+
+    WorldNoise(NoiseBackend backend = SIN_HASH_NOISE, uint64_t seed = 0)
+        : backend(backend), seed(seed)
+    {}
+};
+
+// Noise functions called on a thread that has a WorldNoiseScope
+// open use its WorldNoise; other threads use WorldNoise().
+// Workers open one for the world they are generating.
+class WorldNoiseScope {
+private:
+    WorldNoise m_previous;
+
+public:
+    WorldNoiseScope(const WorldNoise &noise);
+    ~WorldNoiseScope();
+};
+
 vec2 random2(vec2 p);
 vec2 random2(vec3 p);
 vec3 random3(vec3 p);
@@ -38,3 +74,46 @@ float mountainValue(vec2 uv);
 float grasslandValue(vec2 uv);
 float islandValue(vec2 uv);
 float riverNoise(vec2 uv);
+
+// desertValue() is desertTerraceHeight() of the desert's noise. The
+// height steps (terraces) wherever the noise crosses a multiple of
+// 0.01 in [DESERT_TERRACE_MIN, DESERT_TERRACE_MAX], and is smooth
+// elsewhere.
+float desertTerraceHeight(float noise);
+#define DESERT_TERRACE_MIN 0.69f
+#define DESERT_TERRACE_MAX 0.8f
+
+// Batch versions of the functions above. Each one evaluates
+// NOISE_BATCH_SIZE points per call, such as one 16-block row of a
+// Chunk, reading uv[0 .. NOISE_BATCH_SIZE) and writing the same
+// number of results. The lattice hashes shared by neighboring points
+// are computed once per batch, and the rest runs four points at a
+// time in SSE2 registers (or a portable fallback elsewhere).
+// Results match the single-point functions to within
+// NOISE_BATCH_TOLERANCE, since the batches evaluate the surflet
+// falloff polynomial with multiplies instead of pow().
+#define NOISE_BATCH_SIZE 16
+// Largest absolute difference from the single-point functions, for
+// the noise functions (whose results lie roughly in [-1, 1])
+#define NOISE_BATCH_TOLERANCE 1e-5f
+// Largest absolute difference for the *ValueBatch heights, in blocks.
+// desertValue()'s terraces step by up to ~5 blocks, so columns whose
+// noise lands within NOISE_BATCH_TOLERANCE of a step are evaluated
+// with the single-point noise, putting them on the same side of it.
+#define NOISE_BATCH_HEIGHT_TOLERANCE 1e-3f
+
+void perlinNoiseBatch(const vec2 *uv, float *out);
+void fractalPerlinBatch(const vec2 *uv, int octaves, float *out);
+void mountainSummedPerlinBatch(const vec2 *uv, int octaves, float *out);
+void fbmBatch(const vec2 *uv, int octaves, float *out);
+// cellHeights holds each point's starting cell height on input,
+// just like worleyNoise2Point()'s cellHeight
+void worleyNoise2PointBatch(const vec2 *uv, float *out, float *cellHeights);
+
+void biomeValueBatch(const vec2 *uv, vec2 *out);
+// The noise desertValueBatch() feeds to desertTerraceHeight()
+void desertNoiseBatch(const vec2 *uv, float *out);
+void desertValueBatch(const vec2 *uv, float *out);
+void mountainValueBatch(const vec2 *uv, float *out);
+void grasslandValueBatch(const vec2 *uv, float *out);
+void islandValueBatch(const vec2 *uv, float *out);
@@ -32,6 +32,6 @@ void Quad::create()
     // The next few sets of function calls are basically the same as above, except bufPos and bufNor are
     // array buffers rather than element array buffers, as they store vertex attributes like position.
     generateOpq();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpq);
+    mp_context->bindArrayBuffer(m_bufOpq);
     mp_context->glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(float), pos_uv_data, GL_STATIC_DRAW);
 }
@@ -0,0 +1,58 @@
+#include "quadindexbuffer.h"
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+// The largest quad count whose 4 * quadCount vertices can all be
+// addressed by a 16-bit index
+#define MAX_QUADS_16 16384
+
+GLuint QuadIndexBuffer::s_buf16 = 0;
+GLuint QuadIndexBuffer::s_buf32 = 0;
+unsigned int QuadIndexBuffer::s_quads16 = 0;
+unsigned int QuadIndexBuffer::s_quads32 = 0;
+
+template <typename T>
+void QuadIndexBuffer::grow(OpenGLContext *context, GLuint &buf, unsigned int &capacity,
+                           unsigned int quadCount, unsigned int maxQuads) {
+    if (buf == 0) {
+        context->glGenBuffers(1, &buf);
+    }
+    context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buf);
+    if (quadCount <= capacity) {
+        return;
+    }
+    capacity = std::min(std::max(quadCount, 2 * capacity), maxQuads);
+    std::vector<T> idxData;
+    idxData.reserve(6 * capacity);
+    for (unsigned int q = 0; q < capacity; ++q) {
+        T first = static_cast<T>(4 * q);
+        idxData.push_back(first);
+        idxData.push_back(first + 1);
+        idxData.push_back(first + 2);
+        idxData.push_back(first);
+        idxData.push_back(first + 2);
+        idxData.push_back(first + 3);
+    }
+    context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idxData.size() * sizeof(T), idxData.data(), GL_STATIC_DRAW);
+}
+
+void QuadIndexBuffer::bind(OpenGLContext *context, unsigned int quadCount) {
+    if (indexType(quadCount) == GL_UNSIGNED_SHORT) {
+        grow<GLushort>(context, s_buf16, s_quads16, quadCount, MAX_QUADS_16);
+    }
+    else {
+        grow<GLuint>(context, s_buf32, s_quads32, quadCount, std::numeric_limits<GLuint>::max() / 4);
+    }
+}
+
+GLenum QuadIndexBuffer::indexType(unsigned int quadCount) {
+    return quadCount <= MAX_QUADS_16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+void QuadIndexBuffer::destroy(OpenGLContext *context) {
+    context->glDeleteBuffers(1, &s_buf16);
+    context->glDeleteBuffers(1, &s_buf32);
+    s_buf16 = s_buf32 = 0;
+    s_quads16 = s_quads32 = 0;
+}
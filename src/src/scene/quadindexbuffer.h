@@ -0,0 +1,33 @@
+#pragma once
+#include <openglcontext.h>
+
+// The index buffer shared by every Chunk.
+// Chunk meshes are lists of quads whose indices always follow
+// the pattern 0, 1, 2, 0, 2, 3, offset by 4 for each quad, so
+// rather than having every Chunk build and upload its own copy
+// of that pattern, all Chunks draw from one buffer that is grown
+// (by doubling) whenever a Chunk needs more quads than it holds.
+// Meshes of at most 16384 quads (65536 vertices) use a buffer of
+// 16-bit indices, which halves the index data the GPU reads.
+class QuadIndexBuffer {
+private:
+    static GLuint s_buf16, s_buf32;
+    // The number of quads each buffer currently has indices for
+    static unsigned int s_quads16, s_quads32;
+
+    // Grows buf to hold at least quadCount (but never more
+    // than maxQuads) quads, leaving it bound
+    template <typename T>
+    static void grow(OpenGLContext *context, GLuint &buf, unsigned int &capacity,
+                     unsigned int quadCount, unsigned int maxQuads);
+
+public:
+    // Binds a buffer to GL_ELEMENT_ARRAY_BUFFER that holds indices
+    // for at least quadCount quads, of type indexType(quadCount)
+    static void bind(OpenGLContext *context, unsigned int quadCount);
+    // GL_UNSIGNED_SHORT if quadCount quads can be drawn
+    // with 16-bit indices, otherwise GL_UNSIGNED_INT
+    static GLenum indexType(unsigned int quadCount);
+    // Frees both buffers. They are recreated by the next bind().
+    static void destroy(OpenGLContext *context);
+};
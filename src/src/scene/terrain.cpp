@@ -3,26 +3,29 @@
 #include <iostream>
 #include "noise_functions.h"
 #include "chunkworkers.h"
-#include <QThreadPool>
-
-Chunk::Chunk(OpenGLContext *context, int x, int z)
-    : Drawable(context), m_blocks(),
+#include "quadindexbuffer.h"
+#include <QDir>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <algorithm>
+
+Chunk::Chunk(OpenGLContext *context, int x, int z, ChunkMeshArena *meshArena)
+    : Drawable(context), m_sections(), m_sectionsLock(),
       m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr},
                   {ZNEG, nullptr}, {YPOS, nullptr}, {YNEG, nullptr}},
-      m_minX(x), m_minZ(z)
-{
-    fill_n(m_blocks.begin(), 65536, EMPTY);
-}
+      m_minX(x), m_minZ(z), m_pinCount(0), m_hasBlockData(false), m_meshGeneration(0), m_countTra(0),
+      mp_meshArena(meshArena), m_meshOpq(), m_meshTra(), m_minY(256), m_maxY(-1), m_sectionVisibility(), m_sectionsReached(0), m_cullFrame(0)
+{}
 
-// Does bounds checking with at()
+// Does bounds checking
 BlockType Chunk::getBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
-    try {
-        return m_blocks.at(x + 16 * y + 16 * 256 * z);
-    }
-    catch(std::out_of_range &e) {
-        std::cout << e.what() << std::endl;
+    if (x >= 16 || y >= 256 || z >= 16) {
+        std::cout << "Chunk::getBlockAt out of range" << std::endl;
         std::cout << x << ", " << y << ", " << z << std::endl;
+        return EMPTY;
     }
+    QReadLocker locker(&m_sectionsLock);
+    return m_sections[y / 16].getBlockAt(blockIndex(x, y % 16, z));
 }
 
 // Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
@@ -30,24 +33,125 @@ BlockType Chunk::getBlockAt(int x, int y, int z) const {
     return getBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z));
 }
 
-// Does bounds checking with at()
+// Does bounds checking
 void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+    if (x >= 16 || y >= 256 || z >= 16) {
+        throw std::out_of_range("Chunk::setBlockAt(" + std::to_string(x) + ", " + std::to_string(y) +
+                                ", " + std::to_string(z) + ") is out of range!");
+    }
+    QWriteLocker locker(&m_sectionsLock);
+    m_sections[y / 16].setBlockAt(blockIndex(x, y % 16, z), t);
 }
 void Chunk::setBlockAt(int x, int y, int z, BlockType t) {
     setBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z), t);
 }
 
-Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_generatedTerrain(), mp_context(context), m_blocksTexture(context),
-      m_chunksThatHaveBlockData(), m_chunksThatHaveBlockDataLock(), m_chunksThatHaveVBOs(), m_chunksThatHaveVBOsLock()
-{}
+void Chunk::decodeBlocks(BlockType *out) const {
+    QReadLocker locker(&m_sectionsLock);
+    for (const ChunkSection &s : m_sections) {
+        s.decode(out);
+        out += SECTION_VOLUME;
+    }
+}
+
+void Chunk::decodeBlocks(BlockType *out, array<bool, 16> *uniformSections) const {
+    QReadLocker locker(&m_sectionsLock);
+    for (size_t i = 0; i < m_sections.size(); ++i) {
+        m_sections[i].decode(out);
+        (*uniformSections)[i] = m_sections[i].isUniform();
+        out += SECTION_VOLUME;
+    }
+}
+
+void Chunk::encodeBlocks(const BlockType *in) {
+    QWriteLocker locker(&m_sectionsLock);
+    for (ChunkSection &s : m_sections) {
+        s.encode(in);
+        in += SECTION_VOLUME;
+    }
+}
+
+size_t Chunk::memoryUsage() const {
+    QReadLocker locker(&m_sectionsLock);
+    size_t total = sizeof(Chunk);
+    for (const ChunkSection &s : m_sections) {
+        total += s.memoryUsage() - sizeof(ChunkSection);
+    }
+    return total;
+}
+
+void Chunk::writeBlocks(ostream &out) const {
+    QReadLocker locker(&m_sectionsLock);
+    for (const ChunkSection &s : m_sections) {
+        s.write(out);
+    }
+}
+
+bool Chunk::readBlocks(istream &in) {
+    QWriteLocker locker(&m_sectionsLock);
+    for (ChunkSection &s : m_sections) {
+        if (!s.read(in)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Chunk::isSectionUniform(int section) const {
+    QReadLocker locker(&m_sectionsLock);
+    return m_sections.at(section).isUniform();
+}
+
+void Chunk::decodeBorder(Direction side, BlockType *out) const {
+    QReadLocker locker(&m_sectionsLock);
+    for (int y = 0; y < 256; ++y) {
+        const ChunkSection &s = m_sections[y / 16];
+        for (int i = 0; i < 16; ++i) {
+            unsigned int idx;
+            switch (side) {
+            case XPOS: idx = blockIndex(15, y % 16, i); break;
+            case XNEG: idx = blockIndex(0, y % 16, i); break;
+            case ZPOS: idx = blockIndex(i, y % 16, 15); break;
+            case ZNEG: idx = blockIndex(i, y % 16, 0); break;
+            default:
+                throw std::invalid_argument("Chunk::decodeBorder only supports horizontal sides!");
+            }
+            out[i + 16 * y] = s.getBlockAt(idx);
+        }
+    }
+}
+
+Terrain::Terrain(OpenGLContext *context, const WorldNoise &noise)
+    : m_chunks(), m_generatedTerrain(),
+      m_chunkMemoryBudget(TERRAIN_CHUNK_MEMORY_BUDGET), m_zoneLastVisible(), m_visibilityClock(0),
+      m_zonesOnDisk(), m_cacheDir(), m_worldNoise(noise), m_zoneFields(noise),
+      mp_context(context), m_blocksTexture(context),
+      m_chunksThatHaveBlockData(), m_chunksThatHaveBlockDataLock(), m_chunksThatHaveVBOs(), m_chunksThatHaveVBOsLock(),
+      m_chunksAwaitingNeighbors(), m_chunksAwaitingUpload(), m_uploadStats(),
+      m_meshArena(context), m_visibleChunks(), m_visibleMeshes(), m_drawStats(), m_cullFrame(0),
+      m_drawOrigin(0), m_playerPos(0.f),
+      m_jobs(), m_zoneJobTokens()
+{
+    // Each session starts with an empty cache, since evicted
+    // zones are only meaningful to the Terrain that wrote them
+    QDir cacheDir(QDir::tempPath() + "/miniMinecraft-terrain-" +
+                  QString::number(QCoreApplication::applicationPid()));
+    cacheDir.removeRecursively();
+    cacheDir.mkpath(".");
+    m_cacheDir = cacheDir.absolutePath().toStdString();
+}
 
 Terrain::~Terrain() {
+    // Workers write into our Chunks, so let
+    // them finish before deleting anything
+    m_jobs.stop();
     // Destroy all the Chunks
     for (auto &x : this->m_chunks) {
         x.second->destroy();
     }
+    m_meshArena.destroy();
+    QuadIndexBuffer::destroy(mp_context);
+    QDir(QString::fromStdString(m_cacheDir)).removeRecursively();
 }
 
 // Combine two 32-bit ints into one 64-bit int
@@ -165,6 +269,10 @@ void Terrain::setBlockAt(ivec3 p, BlockType t) {
 }
 
 
+float Terrain::getSurfaceHeight(int x, int z) const {
+    return m_zoneFields.surfaceHeight(x, z);
+}
+
 void Terrain::changeBlockAt(glm::ivec3 toChange, BlockType t) {
     setBlockAt(toChange, t);
     uPtr<Chunk>& chunk = getChunkAt(toChange.x, toChange.z);
@@ -206,7 +314,7 @@ void Terrain::changeBlockAt(glm::ivec3 toChange, BlockType t) {
 
 Chunk* Terrain::instantiateChunkAt(int x, int z) {
     // Instantiate the chunk and put it into the map
-    uPtr<Chunk> chunk = mkU<Chunk>(mp_context, x, z);
+    uPtr<Chunk> chunk = mkU<Chunk>(mp_context, x, z, &m_meshArena);
     Chunk *cPtr = chunk.get();
     m_chunks[toKey(x, z)] = move(chunk);
     // Set the neighbor pointers of itself and its neighbors
@@ -229,15 +337,6 @@ Chunk* Terrain::instantiateChunkAt(int x, int z) {
     return cPtr;
 }
 
-const static unordered_map<Direction, Direction, EnumHash> oppositeDirection {
-    {XPOS, XNEG},
-    {XNEG, XPOS},
-    {YPOS, YNEG},
-    {YNEG, YPOS},
-    {ZPOS, ZNEG},
-    {ZNEG, ZPOS}
-};
-
 void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
     if (neighbor != nullptr) {
         this->m_neighbors[dir] = neighbor.get();
@@ -245,6 +344,23 @@ void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
     }
 }
 
+void Chunk::unlinkNeighbors() {
+    for (auto &kvp : m_neighbors) {
+        if (kvp.second != nullptr) {
+            kvp.second->m_neighbors[oppositeDirection.at(kvp.first)] = nullptr;
+            kvp.second = nullptr;
+        }
+    }
+}
+
+array<Chunk*, 6> Chunk::getNeighbors() const {
+    array<Chunk*, 6> result;
+    for (const auto &kvp : m_neighbors) {
+        result[kvp.first] = kvp.second;
+    }
+    return result;
+}
+
 bool crossesBorder(glm::ivec3 pos, glm::ivec3 dir) {
     int dx = (pos.x % 16 + dir.x);
     int dy = (pos.y % 256 + dir.y);
@@ -252,120 +368,173 @@ bool crossesBorder(glm::ivec3 pos, glm::ivec3 dir) {
     return dx < 0 || dy < 0 || dz < 0 || dx >= 16 || dy >= 256 || dz >= 16;
 }
 
+// Synchronously computes and uploads this Chunk's VBO data
+// on the calling (main) thread, e.g. after the player edits a block.
 void Chunk::create() {
-    std::vector<float> vboData;
-    std::vector<GLuint> idxData;
-    GLuint maxIdx = 0;
-    for (int x = 0; x < 16; ++x) {
-        for (int y = 0; y < 256; ++y) {
-            for (int z = 0; z < 16; ++z) {
-                BlockType curr = getBlockAt(x, y, z);
-                if (curr != EMPTY) {
-                    for (const BlockFace &f : adjacentFaces) {
-                        BlockType adj;
-                        if (crossesBorder(glm::ivec3(x, y, z), f.directionVec)) {
-                            Chunk* neighbor = m_neighbors[f.direction];
-                            if (neighbor == nullptr) {
-                                adj = EMPTY;
-                            }
-                            else {
-                                int dx = (x + f.directionVec.x) % 16;
-                                if (dx < 0) dx = 16 + dx;
-                                int dy = (y + f.directionVec.y) % 256;
-                                if (dy < 0) dy = 256 + dy;
-                                int dz = (z + f.directionVec.z) % 16;
-                                if (dz < 0) dz = 16 + dz;
-                                adj = neighbor->getBlockAt(dx, dy, dz);
-                            }
-                        }
-                        else {
-                            adj = getBlockAt(x + f.directionVec.x, y + f.directionVec.y, z + f.directionVec.z);
-                        }
-                        // TODO: Handle transparent stuff differently
-                        if (adj == EMPTY) {
-                            const array<VertexData, 4> &vertDat = f.vertices;
-                            glm::vec2 uvOffset = blockFaceUVs.at(curr).at(f.direction);
-                            for (const VertexData &vd : vertDat) {
-                                // Pos
-                                vboData.push_back(vd.pos.x + x);
-                                vboData.push_back(vd.pos.y + y);
-                                vboData.push_back(vd.pos.z + z);
-                                vboData.push_back(vd.pos.w);
-                                // Nor
-                                vboData.push_back(f.directionVec.x);
-                                vboData.push_back(f.directionVec.y);
-                                vboData.push_back(f.directionVec.z);
-                                vboData.push_back(0);
-                                // UV
-                                vboData.push_back(vd.uv.x + uvOffset.x);
-                                vboData.push_back(vd.uv.y + uvOffset.y);
-                                // Cosine power
-                                // TODO make this not hard-coded
-                                vboData.push_back(1.f);
-                                // Anim flag
-                                // TODO make this not hard-coded
-                                vboData.push_back(0.f);
-                            }
-                            idxData.push_back(0 + maxIdx);
-                            idxData.push_back(1 + maxIdx);
-                            idxData.push_back(2 + maxIdx);
-                            idxData.push_back(0 + maxIdx);
-                            idxData.push_back(2 + maxIdx);
-                            idxData.push_back(3 + maxIdx);
-                            maxIdx += 4;
-                        }
-                    }
-                }
-            }
-        }
-    }
+    // Supersedes any mesh still being built by a VBOWorker
+    ChunkVBOData d(this, getNeighbors(), nullptr, ++m_meshGeneration);
+    VBOWorker::buildVBOData(d);
+    create(d);
+}
 
-    m_count = static_cast<int>(idxData.size());
 
-    generateIdxOpq();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpq);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idxData.size() * sizeof(GLuint), idxData.data(), GL_STATIC_DRAW);
+// Each quad is 4 vertices and 6 indices
+static int quadIndexCount(const vector<GLuint> &vboData) {
+    return static_cast<int>(vboData.size() / (4 * CHUNK_VERTEX_WORDS) * 6);
+}
 
-    generateOpq();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpq);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, vboData.size() * sizeof(float), vboData.data(), GL_STATIC_DRAW);
+void Chunk::create(const ChunkVBOData &d) {
+    const vector<GLuint> &vboDataOpaque = d.m_vboDataOpaque;
+    const vector<GLuint> &vboDataTransparent = d.m_vboDataTransparent;
+    m_count = quadIndexCount(vboDataOpaque);
+    m_countTra = quadIndexCount(vboDataTransparent);
+    m_minY = d.m_minY;
+    m_maxY = d.m_maxY;
+    m_sectionVisibility = d.m_sectionVisibility;
+
+    if (mp_meshArena != nullptr) {
+        mp_meshArena->free(&m_meshOpq);
+        mp_meshArena->free(&m_meshTra);
+        m_meshOpq = mp_meshArena->allocate(vboDataOpaque);
+        m_meshTra = mp_meshArena->allocate(vboDataTransparent);
+    }
 }
 
+void Chunk::destroy() {
+    Drawable::destroy();
+    if (mp_meshArena != nullptr) {
+        mp_meshArena->free(&m_meshOpq);
+        mp_meshArena->free(&m_meshTra);
+    }
+    m_countTra = 0;
+    m_minY = 256;
+    m_maxY = -1;
+}
 
-void Chunk::create(const std::vector<float> &vboDataOpaque, const vector<GLuint> &idxDataOpaque, const std::vector<float> &vboDataTransparent, const vector<GLuint> &idxDataTransparent) {
-    m_count = static_cast<int>(idxDataOpaque.size());
+bool Chunk::meshBounds(glm::vec3 *min, glm::vec3 *max) const {
+    if (m_minY > m_maxY || (m_count <= 0 && m_countTra <= 0)) {
+        return false;
+    }
+    *min = glm::vec3(m_minX, m_minY, m_minZ);
+    *max = glm::vec3(m_minX + 16, m_maxY + 1, m_minZ + 16);
+    return true;
+}
 
-    generateIdxOpq();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpq);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idxDataOpaque.size() * sizeof(GLuint), idxDataOpaque.data(), GL_STATIC_DRAW);
+int Chunk::elemCount(bool opaque) const {
+    return opaque ? m_count : m_countTra;
+}
 
-    generateIdxTra();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxTra);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idxDataTransparent.size() * sizeof(GLuint), idxDataTransparent.data(), GL_STATIC_DRAW);
+const ChunkMeshAllocation& Chunk::mesh(bool opaque) const {
+    return opaque ? m_meshOpq : m_meshTra;
+}
 
-    generateOpq();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpq);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, vboDataOpaque.size() * sizeof(float), vboDataOpaque.data(), GL_STATIC_DRAW);
+void Terrain::cullChunks(int minX, int maxX, int minZ, int maxZ,
+                         const glm::vec3 &eye, const glm::mat4 &viewProj) {
+    Frustum frustum(viewProj);
+    m_visibleChunks.clear();
+    m_drawStats = TerrainDrawStats();
+    m_cullFrame++;
+    m_drawOrigin = glm::ivec2(glm::floor(glm::vec2(eye.x, eye.z) / 16.f));
+
+    // Walk the section visibility graph outward from the camera's
+    // section, only ever stepping through faces that the section we
+    // are in connects to the face we came in by, and never back
+    // towards the camera. Sections outside the frustum or the draw
+    // area are never entered. Only done if the camera is inside a
+    // transparent block of a loaded Chunk; otherwise fall back to
+    // drawing everything in the frustum.
+    glm::ivec3 eyeBlock(glm::floor(eye));
+    bool walkGraph = eyeBlock.y >= 0 && eyeBlock.y < 256 && hasChunkAt(eyeBlock.x, eyeBlock.z) &&
+                     isTransparent(getBlockAt(eyeBlock.x, eyeBlock.y, eyeBlock.z));
+    if (walkGraph) {
+        struct SectionStep {
+            Chunk *chunk;
+            int section;
+            // The face we entered the section by, or -1 for the camera's
+            int entry;
+            // One bit per Direction we have stepped in to get here
+            uint8_t traveled;
+        };
+        Chunk *start = getChunkAt(eyeBlock.x, eyeBlock.z).get();
+        start->m_cullFrame = m_cullFrame;
+        start->m_sectionsReached = 1 << (eyeBlock.y / 16);
+        vector<SectionStep> queue{{start, eyeBlock.y / 16, -1, 0}};
+        for (size_t head = 0; head < queue.size(); ++head) {
+            SectionStep step = queue[head];
+            for (const BlockFace &f : adjacentFaces) {
+                Direction back = oppositeDirection.at(f.direction);
+                if ((step.traveled >> back) & 1) {
+                    continue;
+                }
+                if (step.entry >= 0 &&
+                        !step.chunk->m_sectionVisibility[step.section].connects(Direction(step.entry), f.direction)) {
+                    continue;
+                }
+                Chunk *next = step.chunk;
+                int section = step.section + f.directionVec.y;
+                if (f.directionVec.y == 0) {
+                    next = step.chunk->m_neighbors[f.direction];
+                }
+                if (next == nullptr || section < 0 || section > 15 ||
+                        next->m_minX < minX || next->m_minX > maxX || next->m_minZ < minZ || next->m_minZ > maxZ) {
+                    continue;
+                }
+                if (next->m_cullFrame != m_cullFrame) {
+                    next->m_cullFrame = m_cullFrame;
+                    next->m_sectionsReached = 0;
+                }
+                glm::vec3 boxMin(next->m_minX, 16 * section, next->m_minZ);
+                if ((next->m_sectionsReached >> section) & 1 ||
+                        !frustum.intersectsBox(boxMin, boxMin + glm::vec3(16.f))) {
+                    continue;
+                }
+                next->m_sectionsReached |= 1 << section;
+                queue.push_back({next, section, back, static_cast<uint8_t>(step.traveled | 1 << f.direction)});
+            }
+        }
+    }
 
-    generateTra();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufTra);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, vboDataTransparent.size() * sizeof(float), vboDataTransparent.data(), GL_STATIC_DRAW);
+    for (int x = minX; x <= maxX; x += 16) {
+        for (int z = minZ; z <= maxZ; z += 16) {
+            auto it = m_chunks.find(toKey(x, z));
+            glm::vec3 boxMin, boxMax;
+            if (it == m_chunks.end() || !it->second->meshBounds(&boxMin, &boxMax)) {
+                continue;
+            }
+            Chunk *c = it->second.get();
+            if (!frustum.intersectsBox(boxMin, boxMax)) {
+                m_drawStats.chunksCulled++;
+            }
+            else if (walkGraph && (c->m_cullFrame != m_cullFrame || c->m_sectionsReached == 0)) {
+                m_drawStats.chunksOccluded++;
+            }
+            else {
+                m_visibleChunks.push_back(c);
+                m_drawStats.chunksDrawn++;
+            }
+        }
+    }
 }
 
-void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram, bool opaque) {
+void Terrain::draw(ShaderProgram *shaderProgram, bool opaque) {
     m_blocksTexture.bind(MINECRAFT_BLOCK_TEXTURE_SLOT);
     shaderProgram->setBlockTextureSampler(MINECRAFT_BLOCK_TEXTURE_SLOT);
-    for (int x = minX; x <= maxX; x += 16) {
-        for (int z = minZ; z <= maxZ; z += 16) {
-            if (hasChunkAt(x, z)) {
-                auto &chunk = m_chunks.at(toKey(x, z));
-                if (chunk->elemCount() > 0) {
-                    shaderProgram->setModelMatrix(glm::translate(glm::mat4(), glm::vec3(x, 0, z)));
-                    shaderProgram->draw(*chunk, opaque);
-                }
-            }
+    // Chunk vertices carry their Chunk's position, so
+    // every Chunk is drawn with the same uniforms
+    shaderProgram->setModelMatrix(glm::mat4());
+    shaderProgram->setChunkOrigin(m_drawOrigin);
+    m_visibleMeshes.clear();
+    for (Chunk *chunk : m_visibleChunks) {
+        if (chunk->elemCount(opaque) > 0) {
+            m_visibleMeshes.push_back(&chunk->mesh(opaque));
         }
     }
+    shaderProgram->useMe();
+    m_drawStats.drawCalls += m_meshArena.draw(m_visibleMeshes);
+}
+
+const TerrainDrawStats& Terrain::drawStats() const {
+    return m_drawStats;
 }
 
 void Terrain::initTexture() {
@@ -419,6 +588,199 @@ void Terrain::generateTerrain(int minX, int maxX, int minZ, int maxZ) {
 }
 
 
+void Terrain::setChunkMemoryBudget(size_t bytes) {
+    m_chunkMemoryBudget = bytes;
+}
+
+size_t Terrain::chunkMemoryUsage() const {
+    size_t total = 0;
+    for (const auto &kvp : m_chunks) {
+        total += kvp.second->memoryUsage();
+    }
+    return total;
+}
+
+void Terrain::pinChunk(Chunk *c) {
+    c->m_pinCount++;
+}
+
+void Terrain::unpinChunk(Chunk *c) {
+    c->m_pinCount--;
+}
+
+void Terrain::unpinChunkAndNeighbors(Chunk *c, const array<Chunk*, 6> &neighbors) {
+    unpinChunk(c);
+    for (Chunk *neighbor : neighbors) {
+        if (neighbor != nullptr) {
+            unpinChunk(neighbor);
+        }
+    }
+}
+
+int64_t Terrain::zoneOf(const Chunk *c) const {
+    return toKey(64.f * glm::floor(c->m_minX / 64.f), 64.f * glm::floor(c->m_minZ / 64.f));
+}
+
+bool Terrain::zoneInCreateRadius(int64_t zone) const {
+    ivec2 currZone(64.f * glm::floor(m_playerPos.x / 64.f), 64.f * glm::floor(m_playerPos.z / 64.f));
+    ivec2 offset = glm::abs(toCoords(zone) - currZone);
+    return offset.x <= 64 * TERRAIN_CREATE_RADIUS && offset.y <= 64 * TERRAIN_CREATE_RADIUS;
+}
+
+sPtr<TerrainJobToken> Terrain::zoneJobToken(int64_t zone) {
+    sPtr<TerrainJobToken> &token = m_zoneJobTokens[zone];
+    if (token == nullptr) {
+        token = mkS<TerrainJobToken>();
+    }
+    return token;
+}
+
+void Terrain::cancelZoneJobs(const QSet<int64_t> &zones) {
+    vector<pair<int64_t, sPtr<TerrainJobToken>>> cancelled;
+    for (int64_t zone : zones) {
+        auto it = m_zoneJobTokens.find(zone);
+        if (it != m_zoneJobTokens.end()) {
+            it->second->cancel();
+            cancelled.push_back({zone, it->second});
+            m_zoneJobTokens.erase(it);
+        }
+    }
+
+    // Drop meshing first, since pending VBOWorkers may be what
+    // keeps another zone's Chunks pinned as their neighbors
+    for (const auto &zoneToken : cancelled) {
+        for (QRunnable *job : m_jobs.drop(MESH_JOB, zoneToken.second)) {
+            VBOWorker *worker = static_cast<VBOWorker*>(job);
+            unpinChunkAndNeighbors(worker->mp_chunk, worker->m_neighbors);
+            delete worker;
+        }
+    }
+
+    for (const auto &zoneToken : cancelled) {
+        int64_t zone = zoneToken.first;
+        // The zone's Chunks can only be deleted if its own
+        // generation jobs are the only ones holding them
+        bool heldElsewhere = false;
+        glm::ivec2 coords = toCoords(zone);
+        for (int x = coords.x; x < coords.x + 64; x += 16) {
+            for (int z = coords.y; z < coords.y + 64; z += 16) {
+                auto it = m_chunks.find(toKey(x, z));
+                if (it != m_chunks.end() && it->second->m_pinCount > 1) {
+                    heldElsewhere = true;
+                }
+            }
+        }
+        if (heldElsewhere) {
+            continue;
+        }
+        vector<QRunnable*> jobs = m_jobs.drop(GENERATE_JOB, zoneToken.second);
+        if (jobs.empty()) {
+            continue;
+        }
+        // The Chunks the dropped jobs were to fill, and where
+        // each job was submitted, so it can be submitted again
+        vector<Chunk*> chunks;
+        vector<glm::vec2> positions;
+        bool onDisk = false;
+        for (QRunnable *job : jobs) {
+            if (ZoneLoadWorker *loader = dynamic_cast<ZoneLoadWorker*>(job)) {
+                chunks.insert(chunks.end(), loader->m_chunksToFill.begin(), loader->m_chunksToFill.end());
+                positions.push_back(glm::vec2(loader->m_xCorner + 32, loader->m_zCorner + 32));
+                onDisk = true;
+            }
+            else {
+                Chunk *c = static_cast<FBMWorker*>(job)->mp_chunk;
+                chunks.push_back(c);
+                positions.push_back(glm::vec2(c->m_minX + 8, c->m_minZ + 8));
+            }
+        }
+        // Some of the zone's Chunks were already filled, so the rest
+        // must be too, or the zone would be left with holes in it.
+        // They go under a new token, so that they can still be
+        // dropped if the zone comes back and leaves again.
+        if (chunks.size() < 16) {
+            sPtr<TerrainJobToken> token = zoneJobToken(zone);
+            for (size_t i = 0; i < jobs.size(); ++i) {
+                m_jobs.submit(GENERATE_JOB, positions[i], token, jobs[i]);
+            }
+            continue;
+        }
+        if (onDisk) {
+            // Its blocks are still on disk
+            m_zonesOnDisk.insert(zone);
+        }
+        for (Chunk *c : chunks) {
+            c->unlinkNeighbors();
+            m_chunks.erase(toKey(c->m_minX, c->m_minZ));
+        }
+        m_visibleChunks.clear();
+        m_generatedTerrain.remove(zone);
+        m_zoneLastVisible.erase(zone);
+        for (QRunnable *job : jobs) {
+            delete job;
+        }
+    }
+}
+
+string Terrain::zoneCachePath(int64_t zone) const {
+    ivec2 coords = toCoords(zone);
+    return m_cacheDir + "/zone_" + std::to_string(coords.x) + "_" + std::to_string(coords.y) + ".bin";
+}
+
+void Terrain::evictZonesOverBudget(ivec2 currZone) {
+    size_t usage = chunkMemoryUsage();
+    if (usage <= m_chunkMemoryBudget) {
+        return;
+    }
+    QSet<int64_t> inRange = terrainZonesBorderingZone(currZone, TERRAIN_CREATE_RADIUS, false);
+    // (last visible, zone) pairs, so sorting puts the stalest zones first
+    vector<pair<uint64_t, int64_t>> candidates;
+    for (const auto &kvp : m_zoneLastVisible) {
+        if (!inRange.contains(kvp.first)) {
+            candidates.push_back({kvp.second, kvp.first});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (const auto &candidate : candidates) {
+        if (usage <= m_chunkMemoryBudget) {
+            break;
+        }
+        usage -= std::min(usage, evictZone(candidate.second));
+    }
+}
+
+size_t Terrain::evictZone(int64_t zone) {
+    vector<Chunk*> chunks;
+    glm::ivec2 coords = toCoords(zone);
+    for (int x = coords.x; x < coords.x + 64; x += 16) {
+        for (int z = coords.y; z < coords.y + 64; z += 16) {
+            auto it = m_chunks.find(toKey(x, z));
+            // Still being filled or meshed by a worker
+            if (it == m_chunks.end() || it->second->m_pinCount > 0) {
+                return 0;
+            }
+            chunks.push_back(it->second.get());
+        }
+    }
+    if (!ZoneLoadWorker::writeZone(zoneCachePath(zone), chunks)) {
+        std::cout << "Could not write terrain zone to " << zoneCachePath(zone) << std::endl;
+        return 0;
+    }
+
+    size_t freed = 0;
+    for (Chunk *c : chunks) {
+        freed += c->memoryUsage();
+        c->destroy();
+        c->unlinkNeighbors();
+        m_chunks.erase(toKey(c->m_minX, c->m_minZ));
+    }
+    m_visibleChunks.clear();
+    m_generatedTerrain.remove(zone);
+    m_zoneLastVisible.erase(zone);
+    m_zonesOnDisk.insert(zone);
+    return freed;
+}
+
 bool Terrain::terrainZoneExists(int x, int z) const {
     int64_t key = toKey(x, z);
     return terrainZoneExists(key);
@@ -455,7 +817,11 @@ QSet<int64_t> Terrain::terrainZonesBorderingZone(ivec2 zoneCoords, unsigned int
     return result;
 }
 
-void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev) {
+void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev, glm::vec3 lookDir) {
+    // Re-prioritize the work already queued before adding more
+    m_jobs.setFocus(playerPos, lookDir);
+    m_playerPos = playerPos;
+
     // Find the player's position relative
     // to their current terrain gen zone
     ivec2 currZone(64.f * glm::floor(playerPos.x / 64.f), 64.f * glm::floor(playerPos.z / 64.f));
@@ -467,6 +833,7 @@ void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev) {
     QSet<int64_t> terrainZonesBorderingPrevPos = terrainZonesBorderingZone(prevZone, TERRAIN_CREATE_RADIUS, false);
     // Check which terrain zones need to be destroy()ed
     // by determining which terrain zones were previously in our radius and are now not
+    QSet<int64_t> terrainZonesLeavingRadius;
     for (auto id : terrainZonesBorderingPrevPos) {
         if (!terrainZonesBorderingCurrPos.contains(id)) {
             ivec2 coord = toCoords(id);
@@ -476,8 +843,12 @@ void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev) {
                     chunk->destroy();
                 }
             }
+            terrainZonesLeavingRadius.insert(id);
         }
     }
+    // Don't spend any more time on zones we just
+    // destroy()ed, and don't upload what is already done
+    cancelZoneJobs(terrainZonesLeavingRadius);
 
     // Determine if any terrain zones around our current position need VBO data.
     // Send these to VBOWorkers.
@@ -489,11 +860,13 @@ void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev) {
         // at some point, and may even already have VBOs
         if (terrainZoneExists(id)) {
             if (!terrainZonesBorderingPrevPos.contains(id)) {
+                // cancelZoneJobs() forgot its token when it left
+                zoneJobToken(id);
                 ivec2 coord = toCoords(id);
                 for (int x = coord.x; x < coord.x + 64; x += 16) {
                     for (int z = coord.y; z < coord.y + 64; z += 16) {
                         auto &chunk = getChunkAt(x, z);
-                        spawnVBOWorker(chunk.get());
+                        meshWhenReady(chunk.get());
                     }
                 }
             }
@@ -504,6 +877,13 @@ void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev) {
         else {
             spawnFBMWorker(id);
         }
+        m_zoneLastVisible[id] = m_visibilityClock;
+    }
+    m_visibilityClock++;
+
+    // Only zones that just left our radius can have become evictable
+    if (currZone != prevZone) {
+        evictZonesOverBudget(currZone);
     }
 }
 
@@ -597,12 +977,29 @@ void Terrain::spawnFBMWorker(int64_t zoneToGenerate) {
         for (int z = coords.y; z < coords.y + 64; z += 16) {
             Chunk* c = instantiateChunkAt(x, z);
             c->m_count = 0; // Allow it to be "drawn" even with no VBO data
+            pinChunk(c);
             chunksForWorker.push_back(c);
         }
     }
-    FBMWorker *worker = new FBMWorker(coords.x, coords.y, chunksForWorker,
-                                      &m_chunksThatHaveBlockData, &m_chunksThatHaveBlockDataLock);
-    QThreadPool::globalInstance()->start(worker);
+    sPtr<TerrainJobToken> token = zoneJobToken(zoneToGenerate);
+    // Zones we evicted earlier are read back from disk, which
+    // also preserves any blocks the player changed in them
+    if (m_zonesOnDisk.contains(zoneToGenerate)) {
+        m_zonesOnDisk.remove(zoneToGenerate);
+        ZoneLoadWorker *worker = new ZoneLoadWorker(coords.x, coords.y, m_worldNoise, &m_zoneFields,
+                                                    zoneCachePath(zoneToGenerate),
+                                                    chunksForWorker, &m_chunksThatHaveBlockData,
+                                                    &m_chunksThatHaveBlockDataLock);
+        m_jobs.submit(GENERATE_JOB, glm::vec2(coords) + glm::vec2(32.f), token, worker);
+        return;
+    }
+    // One job per Chunk, so the Chunks nearest the
+    // player are generated (and meshed) first
+    for (Chunk *c : chunksForWorker) {
+        FBMWorker *worker = new FBMWorker(c, m_worldNoise, &m_zoneFields,
+                                          &m_chunksThatHaveBlockData, &m_chunksThatHaveBlockDataLock);
+        m_jobs.submit(GENERATE_JOB, glm::vec2(c->m_minX + 8, c->m_minZ + 8), token, worker);
+    }
 }
 
 void Terrain::spawnFBMWorkers(const QSet<int64_t> &zonesToGenerate) {
@@ -613,8 +1010,17 @@ void Terrain::spawnFBMWorkers(const QSet<int64_t> &zonesToGenerate) {
 }
 
 void Terrain::spawnVBOWorker(Chunk* chunkNeedingVBOData) {
-    VBOWorker *worker = new VBOWorker(chunkNeedingVBOData, &m_chunksThatHaveVBOs, &m_chunksThatHaveVBOsLock);
-    QThreadPool::globalInstance()->start(worker);
+    // The worker reads the Chunk and the borders of its neighbors
+    pinChunk(chunkNeedingVBOData);
+    for (Chunk *neighbor : chunkNeedingVBOData->getNeighbors()) {
+        if (neighbor != nullptr) {
+            pinChunk(neighbor);
+        }
+    }
+    sPtr<TerrainJobToken> token = zoneJobToken(zoneOf(chunkNeedingVBOData));
+    VBOWorker *worker = new VBOWorker(chunkNeedingVBOData, token, &m_chunksThatHaveVBOs, &m_chunksThatHaveVBOsLock);
+    m_jobs.submit(MESH_JOB, glm::vec2(chunkNeedingVBOData->m_minX + 8, chunkNeedingVBOData->m_minZ + 8),
+                  token, worker);
 }
 
 void Terrain::spawnVBOWorkers(const std::unordered_set<Chunk*> &chunksNeedingVBOs) {
@@ -623,23 +1029,132 @@ void Terrain::spawnVBOWorkers(const std::unordered_set<Chunk*> &chunksNeedingVBO
     }
 }
 
+void Terrain::meshWhenReady(Chunk *c) {
+    m_chunksAwaitingNeighbors.insert(toKey(c->m_minX, c->m_minZ));
+}
+
+bool Terrain::readyToMesh(const Chunk *c) const {
+    if (!c->m_hasBlockData) {
+        return false;
+    }
+    for (const Chunk *neighbor : c->getNeighbors()) {
+        if (neighbor != nullptr && !neighbor->m_hasBlockData) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Terrain::spawnReadyVBOWorkers() {
+    for (auto it = m_chunksAwaitingNeighbors.begin(); it != m_chunksAwaitingNeighbors.end();) {
+        auto chunk = m_chunks.find(*it);
+        // Forget Chunks that were deleted, and those of zones that
+        // left our radius, which are re-queued if they come back
+        if (chunk == m_chunks.end() || !zoneInCreateRadius(zoneOf(chunk->second.get()))) {
+            it = m_chunksAwaitingNeighbors.erase(it);
+        }
+        else if (readyToMesh(chunk->second.get())) {
+            spawnVBOWorker(chunk->second.get());
+            it = m_chunksAwaitingNeighbors.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
 void Terrain::checkThreadResults() {
-    // Send Chunks that have been processed by FBMWorkers
-    // to VBOWorkers for VBO data
+    // Hold each lock just long enough to take everything the
+    // workers have finished, so they never wait on the GPU
+    unordered_set<Chunk*> chunksWithBlockData;
     m_chunksThatHaveBlockDataLock.lock();
-    spawnVBOWorkers(m_chunksThatHaveBlockData);
-    m_chunksThatHaveBlockData.clear();
+    chunksWithBlockData.swap(m_chunksThatHaveBlockData);
     m_chunksThatHaveBlockDataLock.unlock();
 
-    // Collect the Chunks that have been given VBO data
-    // by VBOWorkers and send that VBO data to the GPU.
-    m_chunksThatHaveVBOsLock.lock();
-    for (ChunkVBOData cd : m_chunksThatHaveVBOs) {
-        cd.mp_chunk->create(cd.m_vboDataOpaque, cd.m_idxDataOpaque,
-                            cd.m_vboDataTransparent, cd.m_idxDataTransparent);
+    // Send Chunks that have been processed by FBMWorkers to
+    // VBOWorkers for VBO data, each as soon as it and its
+    // neighbors are filled, since meshing reads their borders
+    for (Chunk *c : chunksWithBlockData) {
+        unpinChunk(c);
+        c->m_hasBlockData = true;
+        // Zones that left our radius while they were being generated
+        // are meshed by tryExpansion() once they come back into it
+        if (zoneInCreateRadius(zoneOf(c))) {
+            meshWhenReady(c);
+        }
     }
-    m_chunksThatHaveVBOs.clear();
+    spawnReadyVBOWorkers();
+
+    // Collect the Chunks that have been given VBO data by VBOWorkers
+    vector<ChunkVBOData> chunksWithVBOs;
+    m_chunksThatHaveVBOsLock.lock();
+    chunksWithVBOs.swap(m_chunksThatHaveVBOs);
     m_chunksThatHaveVBOsLock.unlock();
+    for (ChunkVBOData &cd : chunksWithVBOs) {
+        m_chunksAwaitingUpload.push_back(std::move(cd));
+    }
+
+    // Throw away data for zones that left our radius, even if it
+    // was waiting here when they did, and data that a newer mesh
+    // of its Chunk has superseded: one rebuilt by changeBlockAt(),
+    // or one requested since. This leaves at most one mesh per
+    // Chunk, so their upload order doesn't matter.
+    auto discarded = [](const ChunkVBOData &cd) {
+        return cd.mp_token->isCancelled() ||
+               cd.m_meshGeneration != cd.mp_chunk->m_meshGeneration;
+    };
+    for (ChunkVBOData &cd : m_chunksAwaitingUpload) {
+        if (discarded(cd)) {
+            unpinChunkAndNeighbors(cd.mp_chunk, cd.mp_neighbors);
+        }
+    }
+    m_chunksAwaitingUpload.erase(std::remove_if(m_chunksAwaitingUpload.begin(), m_chunksAwaitingUpload.end(), discarded),
+                                 m_chunksAwaitingUpload.end());
+
+    // The player may have moved since last tick, so re-sort
+    // with the closest Chunk at the back
+    glm::vec2 player(m_playerPos.x, m_playerPos.z);
+    auto distance2 = [&](const ChunkVBOData &cd) {
+        glm::vec2 d = glm::vec2(cd.mp_chunk->m_minX + 8, cd.mp_chunk->m_minZ + 8) - player;
+        return glm::dot(d, d);
+    };
+    std::sort(m_chunksAwaitingUpload.begin(), m_chunksAwaitingUpload.end(),
+              [&](const ChunkVBOData &a, const ChunkVBOData &b) {
+        return distance2(a) > distance2(b);
+    });
+
+    // Send VBO data to the GPU until we run out of budget. The first
+    // Chunk is always sent, so one huge Chunk can't stall the queue.
+    auto vboBytes = [](const ChunkVBOData &cd) {
+        return (cd.m_vboDataOpaque.size() + cd.m_vboDataTransparent.size()) * sizeof(GLuint);
+    };
+    TerrainUploadStats stats;
+    QElapsedTimer timer;
+    timer.start();
+    while (!m_chunksAwaitingUpload.empty()) {
+        ChunkVBOData &cd = m_chunksAwaitingUpload.back();
+        size_t bytes = vboBytes(cd);
+        if (stats.chunksUploaded > 0 &&
+                (timer.elapsed() >= TERRAIN_UPLOAD_BUDGET_MS ||
+                 stats.bytesUploaded + bytes > TERRAIN_UPLOAD_BUDGET_BYTES)) {
+            break;
+        }
+        cd.mp_chunk->create(cd);
+        unpinChunkAndNeighbors(cd.mp_chunk, cd.mp_neighbors);
+        stats.chunksUploaded++;
+        stats.bytesUploaded += bytes;
+        m_chunksAwaitingUpload.pop_back();
+    }
+    for (const ChunkVBOData &cd : m_chunksAwaitingUpload) {
+        stats.chunksDeferred++;
+        stats.bytesDeferred += vboBytes(cd);
+    }
+    stats.ticksBehind = stats.chunksDeferred > 0 ? m_uploadStats.ticksBehind + 1 : 0;
+    m_uploadStats = stats;
+}
+
+const TerrainUploadStats& Terrain::uploadStats() const {
+    return m_uploadStats;
 }
 
 bool Terrain::initialTerrainDoneLoading() const {
@@ -7,6 +7,10 @@
 #include "shaderprogram.h"
 #include "texture.h"
 #include "chunk.h"
+#include "noise_functions.h"
+#include "terrainjobs.h"
+#include "zonefieldcache.h"
+#include "frustum.h"
 #include <QMutex>
 #include <QSet>
 
@@ -16,11 +20,54 @@ using namespace std;
 #define TERRAIN_DRAW_RADIUS 3
 // Keep the VBO data of all terrain zones within a radius of 2 from our current zone
 #define TERRAIN_CREATE_RADIUS 4
+// How long checkThreadResults() may spend sending VBO data to
+// the GPU each tick, and how many bytes it may send. Whatever
+// doesn't fit is sent on later ticks, closest Chunks first.
+#define TERRAIN_UPLOAD_BUDGET_MS 4
+#define TERRAIN_UPLOAD_BUDGET_BYTES (8 * 1024 * 1024)
+// Default upper bound, in bytes, on the block data kept in memory.
+// Zones beyond this are written to disk and evicted.
+#define TERRAIN_CHUNK_MEMORY_BUDGET (64 * 1024 * 1024)
+
+// What checkThreadResults() sent to the GPU on the last tick,
+// and how much it had to leave for later ticks
+struct TerrainUploadStats {
+    int chunksUploaded;
+    size_t bytesUploaded;
+    int chunksDeferred;
+    size_t bytesDeferred;
+    // Ticks since the upload queue was last emptied
+    int ticksBehind;
+
+    TerrainUploadStats()
+        : chunksUploaded(0), bytesUploaded(0),
+          chunksDeferred(0), bytesDeferred(0), ticksBehind(0)
+    {}
+};
+
+// What the last cullChunks() found among the Chunks it was asked about.
+// Chunks with nothing to draw are counted as none of these.
+struct TerrainDrawStats {
+    // Chunks at least partly inside the view frustum, and not
+    // hidden behind solid blocks
+    int chunksDrawn;
+    // Chunks entirely outside it, which draw() skips
+    int chunksCulled;
+    // Chunks inside it but hidden behind solid blocks, which draw()
+    // also skips
+    int chunksOccluded;
+    // The draw calls made by draw() since that cullChunks()
+    int drawCalls;
+
+    TerrainDrawStats()
+        : chunksDrawn(0), chunksCulled(0), chunksOccluded(0), drawCalls(0)
+    {}
+};
 
 // The container class for all of the Chunks in the game.
-// Ultimately, while Terrain will always store all Chunks,
-// not all Chunks will be drawn at any given time as the world
-// expands.
+// Not all Chunks will be drawn at any given time as the world
+// expands, and once the Chunks in memory exceed a budget the
+// least recently visible terrain zones are spilled to disk.
 class Terrain {
 private:
     // Stores every Chunk according to the location of its lower-left corner
@@ -42,9 +89,35 @@ private:
     // world to add more "terrain generation zone" IDs to this set.
     // While only the 3 x 3 collection of terrain generation zones
     // surrounding the Player should be rendered, the Chunks
-    // in the Terrain will never be deleted until the program is terminated.
+    // in the Terrain stay in memory until their zone is evicted
+    // (see m_chunkMemoryBudget), at which point the zone is
+    // removed from this set and added to m_zonesOnDisk.
     QSet<int64_t> m_generatedTerrain;
 
+    // Once the block data of m_chunks takes up more than this
+    // many bytes, the least recently visible terrain zones outside
+    // TERRAIN_CREATE_RADIUS are written to m_cacheDir and deleted.
+    size_t m_chunkMemoryBudget;
+    // The value of m_visibilityClock when each zone in
+    // m_generatedTerrain was last within TERRAIN_CREATE_RADIUS
+    // of the player. Incremented once per tryExpansion().
+    unordered_map<int64_t, uint64_t> m_zoneLastVisible;
+    uint64_t m_visibilityClock;
+    // Evicted zones whose blocks are stored in m_cacheDir.
+    // When one of these comes back into range it is read
+    // back by a ZoneLoadWorker rather than regenerated.
+    QSet<int64_t> m_zonesOnDisk;
+    // Directory holding this session's evicted zones
+    string m_cacheDir;
+
+    // The noise backend and seed this world is generated with
+    WorldNoise m_worldNoise;
+    // The 2D noise fields of recently generated zones, shared by
+    // the FBMWorkers and getSurfaceHeight() (which picks where the
+    // player spawns). Filling it in is
+    // invisible to users of a const Terrain, hence mutable.
+    mutable ZoneFieldCache m_zoneFields;
+
     OpenGLContext *mp_context;
 
     Texture m_blocksTexture;
@@ -55,9 +128,78 @@ private:
     QMutex m_chunksThatHaveBlockDataLock;
     vector<ChunkVBOData> m_chunksThatHaveVBOs;
     QMutex m_chunksThatHaveVBOsLock;
+    // Keys of the Chunks to mesh once they and their neighbors have
+    // block data (see readyToMesh()). Only touched by the main thread.
+    unordered_set<int64_t> m_chunksAwaitingNeighbors;
+    // VBO data collected from m_chunksThatHaveVBOs that has not been
+    // sent to the GPU yet, sorted so the Chunk closest to the player
+    // is at the back. Only touched by the main thread.
+    vector<ChunkVBOData> m_chunksAwaitingUpload;
+    TerrainUploadStats m_uploadStats;
+    // Holds the meshes of every Chunk on the GPU
+    ChunkMeshArena m_meshArena;
+    // The Chunks the next draw() calls will draw, as of the last
+    // cullChunks(). Cleared whenever Chunks are deleted.
+    vector<Chunk*> m_visibleChunks;
+    // Scratch space for draw(), reused from frame to frame
+    vector<const ChunkMeshAllocation*> m_visibleMeshes;
+    TerrainDrawStats m_drawStats;
+    // Counts cullChunks() calls, so Chunks can tell whether their
+    // m_sectionsReached is from this frame
+    uint64_t m_cullFrame;
+    // The x / 16 and z / 16 of the Chunk the camera was in at the
+    // last cullChunks(), which draw() positions Chunks relative to
+    glm::ivec2 m_drawOrigin;
+    // Where the player was at the last tryExpansion()
+    glm::vec3 m_playerPos;
+
+    // Runs the FBMWorkers, ZoneLoadWorkers and VBOWorkers
+    // above, nearest to the player's view first
+    TerrainJobScheduler m_jobs;
+    // The token shared by every job submitted for each zone since it
+    // last came within TERRAIN_CREATE_RADIUS. A zone that leaves the
+    // radius has its token cancelled and removed from this map, unless
+    // it is left to finish generating, which it does under a new token.
+    unordered_map<int64_t, sPtr<TerrainJobToken>> m_zoneJobTokens;
+
+    // A Chunk is pinned for as long as a worker holds a pointer to it
+    void pinChunk(Chunk *c);
+    void unpinChunk(Chunk *c);
+    // Releases the pins a VBOWorker took on c and its neighbors
+    void unpinChunkAndNeighbors(Chunk *c, const array<Chunk*, 6> &neighbors);
+    // Queues c to be meshed by spawnReadyVBOWorkers()
+    void meshWhenReady(Chunk *c);
+    // Whether c and every neighbor it has are filled with blocks,
+    // so a VBOWorker won't see a neighbor that is still empty
+    // and mesh c's border against it
+    bool readyToMesh(const Chunk *c) const;
+    // Spawns a VBOWorker for every queued Chunk that is readyToMesh()
+    void spawnReadyVBOWorkers();
+    // Key of the terrain zone containing c
+    int64_t zoneOf(const Chunk *c) const;
+    // Whether the zone is within TERRAIN_CREATE_RADIUS of the
+    // zone the player was in at the last tryExpansion()
+    bool zoneInCreateRadius(int64_t zone) const;
+    // The token to submit the zone's jobs with, creating it if need be
+    sPtr<TerrainJobToken> zoneJobToken(int64_t zone);
+    // Cancels the jobs of zones that left TERRAIN_CREATE_RADIUS.
+    // Jobs that have not started are dropped: meshing is simply
+    // skipped, and a zone none of whose Chunks were generated is
+    // forgotten so that it is generated afresh if the player returns.
+    // A partly generated zone is left to finish generating.
+    void cancelZoneJobs(const QSet<int64_t> &zones);
+    // Path of the file that holds the given zone while it is evicted
+    string zoneCachePath(int64_t zone) const;
+    // Evicts zones, least recently visible first, until the block data
+    // of m_chunks fits in m_chunkMemoryBudget. Never evicts a zone within
+    // TERRAIN_CREATE_RADIUS of currZone, or one with a pinned Chunk.
+    void evictZonesOverBudget(glm::ivec2 currZone);
+    // Writes the zone's blocks to disk, then unlinks and deletes its Chunks.
+    // Returns the number of bytes freed, or 0 if the zone could not be evicted.
+    size_t evictZone(int64_t zone);
 
 public:
-    Terrain(OpenGLContext *context);
+    Terrain(OpenGLContext *context, const WorldNoise &noise = WorldNoise());
     ~Terrain();
 
     // Instantiates a new Chunk and stores it in
@@ -86,24 +228,49 @@ public:
 
     void changeBlockAt(glm::ivec3 toChange, BlockType t);
 
+    // The height of the generated terrain at world-space column
+    // (x, z), as described by ZoneFieldCache::surfaceHeight().
+    // Works whether or not the column's Chunk exists, without
+    // reading any blocks, so it doesn't see the player's changes.
+    float getSurfaceHeight(int x, int z) const;
+
     bool terrainZoneExists(int x, int z) const;
     bool terrainZoneExists(int64_t id) const;
 
-    // Draws every Chunk that falls within the bounding box
-    // described by the min and max coords, using the provided
-    // ShaderProgram
-    void draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram, bool opaque);
+    void setChunkMemoryBudget(size_t bytes);
+    // Approximate memory used by the block data of every Chunk in m_chunks
+    size_t chunkMemoryUsage() const;
+
+    // Finds the Chunks that fall within the bounding box described
+    // by the min and max coords and that the camera at eye with the
+    // given view-projection matrix can see, for this frame's draw()
+    // calls. Chunks outside the view frustum are skipped, and so are
+    // Chunks that no path of transparent blocks from the camera
+    // could reach, going by each section's SectionVisibility.
+    void cullChunks(int minX, int maxX, int minZ, int maxZ,
+                    const glm::vec3 &eye, const glm::mat4 &viewProj);
+    // Draws every Chunk the last cullChunks() found,
+    // using the provided ShaderProgram, with a few
+    // draw calls per block of our ChunkMeshArena
+    void draw(ShaderProgram *shaderProgram, bool opaque);
+    const TerrainDrawStats& drawStats() const;
     void initTexture();
 
     // Generate procedural terrain height for all the blocks in the given bounding box
     // Also creates the Chunks that will fall into this zone.
     void generateTerrain(int minX, int maxX, int minZ, int maxZ);
-    void tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev);
+    // lookDir is the player's view direction, used
+    // to decide which pending work to do first
+    void tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev, glm::vec3 lookDir);
     void spawnFBMWorkers(const QSet<int64_t> &zonesToGenerate);
     void spawnFBMWorker(int64_t zoneToGenerate);
     void spawnVBOWorkers(const std::unordered_set<Chunk *> &chunksNeedingVBOs);
     void spawnVBOWorker(Chunk* chunkNeedingVBOData);
+    // Spawns VBOWorkers for newly generated Chunks, then sends
+    // as much finished VBO data to the GPU as fits in
+    // TERRAIN_UPLOAD_BUDGET_MS and TERRAIN_UPLOAD_BUDGET_BYTES
     void checkThreadResults();
+    const TerrainUploadStats& uploadStats() const;
     bool initialTerrainDoneLoading() const;
     QSet<int64_t> terrainZonesBorderingZone(glm::ivec2 zoneCoords, unsigned int radius, bool onlyCircumference) const;
 
@@ -0,0 +1,155 @@
+#include "terrainjobs.h"
+#include <algorithm>
+
+TerrainJobToken::TerrainJobToken()
+    : m_cancelled(false)
+{}
+
+void TerrainJobToken::cancel() {
+    m_cancelled = true;
+}
+
+bool TerrainJobToken::isCancelled() const {
+    return m_cancelled;
+}
+
+TerrainJobThread::TerrainJobThread(TerrainJobScheduler *scheduler)
+    : mp_scheduler(scheduler)
+{}
+
+void TerrainJobThread::run() {
+    while (QRunnable *job = mp_scheduler->takeJob()) {
+        job->run();
+        if (job->autoDelete()) {
+            delete job;
+        }
+    }
+}
+
+TerrainJobScheduler::TerrainJobScheduler(int threadCount)
+    : m_queue(), m_queueLock(), m_jobAvailable(), m_pendingByType{0, 0},
+      m_nextOrder(0), m_stopping(false),
+      m_focusPos(0.f), m_focusDir(0.f, 1.f), m_threads()
+{
+    for (int i = 0; i < std::max(1, threadCount); ++i) {
+        m_threads.push_back(mkU<TerrainJobThread>(this));
+        m_threads.back()->start();
+    }
+}
+
+TerrainJobScheduler::~TerrainJobScheduler() {
+    stop();
+}
+
+int TerrainJobScheduler::defaultThreadCount() {
+    // Leave a core free for the main thread, which
+    // still has to upload every finished Chunk
+    return std::max(1, QThread::idealThreadCount() - 1);
+}
+
+float TerrainJobScheduler::priorityOf(TerrainJobType type, glm::vec2 center) const {
+    float penalty = type == GENERATE_JOB ? TERRAIN_GENERATE_JOB_PENALTY : 0.f;
+    glm::vec2 toJob = center - m_focusPos;
+    float dist = glm::length(toJob);
+    if (dist < 1.f) {
+        return penalty;
+    }
+    // Jobs straight ahead count as half as far away as they
+    // really are, and jobs straight behind as half again as far
+    float cosAngle = glm::dot(toJob / dist, m_focusDir);
+    return dist * (1.f - 0.5f * cosAngle) + penalty;
+}
+
+bool TerrainJobScheduler::lessUrgent(const Job &a, const Job &b) {
+    if (a.priority != b.priority) {
+        return a.priority > b.priority;
+    }
+    return a.order > b.order;
+}
+
+QRunnable* TerrainJobScheduler::takeJob() {
+    QMutexLocker locker(&m_queueLock);
+    while (!m_stopping && m_queue.empty()) {
+        m_jobAvailable.wait(&m_queueLock);
+    }
+    if (m_stopping) {
+        return nullptr;
+    }
+    std::pop_heap(m_queue.begin(), m_queue.end(), lessUrgent);
+    Job job = m_queue.back();
+    m_queue.pop_back();
+    m_pendingByType[job.type]--;
+    return job.runnable;
+}
+
+void TerrainJobScheduler::submit(TerrainJobType type, glm::vec2 center,
+                                 const sPtr<TerrainJobToken> &token, QRunnable *runnable) {
+    QMutexLocker locker(&m_queueLock);
+    if (m_stopping) {
+        if (runnable->autoDelete()) {
+            delete runnable;
+        }
+        return;
+    }
+    m_queue.push_back(Job{type, center, runnable, token, priorityOf(type, center), m_nextOrder++});
+    std::push_heap(m_queue.begin(), m_queue.end(), lessUrgent);
+    m_pendingByType[type]++;
+    m_jobAvailable.wakeOne();
+}
+
+vector<QRunnable*> TerrainJobScheduler::drop(TerrainJobType type, const sPtr<TerrainJobToken> &token) {
+    QMutexLocker locker(&m_queueLock);
+    vector<QRunnable*> dropped;
+    auto toDrop = [&](const Job &job) {
+        return job.type == type && job.token == token;
+    };
+    for (const Job &job : m_queue) {
+        if (toDrop(job)) {
+            dropped.push_back(job.runnable);
+        }
+    }
+    if (!dropped.empty()) {
+        m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(), toDrop), m_queue.end());
+        std::make_heap(m_queue.begin(), m_queue.end(), lessUrgent);
+        m_pendingByType[type] -= static_cast<int>(dropped.size());
+    }
+    return dropped;
+}
+
+void TerrainJobScheduler::setFocus(glm::vec3 pos, glm::vec3 forward) {
+    QMutexLocker locker(&m_queueLock);
+    m_focusPos = glm::vec2(pos.x, pos.z);
+    glm::vec2 dir(forward.x, forward.z);
+    // Looking straight up or down favors no direction
+    m_focusDir = glm::length(dir) > 1e-4f ? glm::normalize(dir) : glm::vec2(0.f);
+    for (Job &job : m_queue) {
+        job.priority = priorityOf(job.type, job.center);
+    }
+    std::make_heap(m_queue.begin(), m_queue.end(), lessUrgent);
+}
+
+int TerrainJobScheduler::pendingJobs(TerrainJobType type) const {
+    QMutexLocker locker(&m_queueLock);
+    return m_pendingByType[type];
+}
+
+void TerrainJobScheduler::stop() {
+    {
+        QMutexLocker locker(&m_queueLock);
+        if (m_stopping) {
+            return;
+        }
+        m_stopping = true;
+        for (Job &job : m_queue) {
+            if (job.runnable->autoDelete()) {
+                delete job.runnable;
+            }
+        }
+        m_queue.clear();
+        m_pendingByType = {0, 0};
+        m_jobAvailable.wakeAll();
+    }
+    for (auto &thread : m_threads) {
+        thread->wait();
+    }
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include "glm_includes.h"
+#include "smartpointerhelp.h"
+#include <QRunnable>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+// The kinds of work Terrain hands to its worker threads
+enum TerrainJobType {
+    // Fill a terrain zone's Chunks with blocks (FBMWorker or ZoneLoadWorker)
+    GENERATE_JOB,
+    // Build a Chunk's VBO data (VBOWorker)
+    MESH_JOB
+};
+
+// How much farther away, in blocks, a GENERATE_JOB counts as than a
+// MESH_JOB at the same place. Meshing is what puts terrain on screen,
+// so a Chunk that is ready to mesh goes before generating others
+// about as near, which would only queue up more meshing.
+#define TERRAIN_GENERATE_JOB_PENALTY 16.f
+
+// Shared by Terrain and every job it submits for one terrain zone.
+// Terrain cancels it from the main thread when the zone leaves
+// TERRAIN_CREATE_RADIUS. Workers that have already started check
+// it so they can skip work, and Terrain checks it again before
+// using their results, since a job may be cancelled at any point.
+class TerrainJobToken {
+private:
+    std::atomic<bool> m_cancelled;
+
+public:
+    TerrainJobToken();
+    void cancel();
+    bool isCancelled() const;
+};
+
+class TerrainJobScheduler;
+
+// One of the threads owned by a TerrainJobScheduler.
+// Runs jobs, most urgent first, until the scheduler stops.
+class TerrainJobThread : public QThread {
+private:
+    TerrainJobScheduler *mp_scheduler;
+
+public:
+    TerrainJobThread(TerrainJobScheduler *scheduler);
+    void run() override;
+};
+
+// Runs Terrain's worker jobs on a dedicated set of threads.
+// Unlike a QThreadPool, which runs jobs in the order they were
+// started, pending jobs are kept in a priority queue ordered by how
+// far they are from the player, with jobs in front of the camera
+// favored over those behind it, and meshing over generation (see
+// TERRAIN_GENERATE_JOB_PENALTY). Since the player keeps moving,
+// setFocus() re-orders every pending job once per tick, so the
+// Chunks the player is about to see are generated and meshed first.
+class TerrainJobScheduler {
+private:
+    struct Job {
+        TerrainJobType type;
+        // World-space x-z center of the zone or Chunk the job works on
+        glm::vec2 center;
+        QRunnable *runnable;
+        sPtr<TerrainJobToken> token;
+        // Lower runs sooner
+        float priority;
+        // Breaks ties in submission order
+        uint64_t order;
+    };
+
+    // A binary heap with the most urgent job at the front
+    vector<Job> m_queue;
+    mutable QMutex m_queueLock;
+    QWaitCondition m_jobAvailable;
+    array<int, 2> m_pendingByType;
+    uint64_t m_nextOrder;
+    bool m_stopping;
+
+    // The player's x-z position and (normalized) x-z view direction
+    glm::vec2 m_focusPos, m_focusDir;
+
+    vector<uPtr<TerrainJobThread>> m_threads;
+
+    // Distance from the focus, weighted by view direction and type
+    float priorityOf(TerrainJobType type, glm::vec2 center) const;
+    // Heap comparator: is a less urgent than b?
+    static bool lessUrgent(const Job &a, const Job &b);
+
+    // Blocks until a job is available and removes it from the queue.
+    // Returns nullptr once the scheduler is stopping.
+    QRunnable* takeJob();
+
+    friend class TerrainJobThread;
+
+public:
+    // Starts threadCount threads to run jobs on
+    TerrainJobScheduler(int threadCount = defaultThreadCount());
+    ~TerrainJobScheduler();
+
+    // One thread per core, except one left for the main thread
+    static int defaultThreadCount();
+
+    // Queues runnable, which is deleted after it runs if it is
+    // autoDelete(), just as QThreadPool::start() would.
+    // token identifies the job for drop().
+    void submit(TerrainJobType type, glm::vec2 center,
+                const sPtr<TerrainJobToken> &token, QRunnable *runnable);
+    // Removes every pending job of the given type that was submitted
+    // with token, and returns their runnables without running or
+    // deleting them, so the caller can undo whatever it set up for them
+    vector<QRunnable*> drop(TerrainJobType type, const sPtr<TerrainJobToken> &token);
+    // Moves the player to pos, looking along forward, and
+    // re-prioritizes every pending job accordingly
+    void setFocus(glm::vec3 pos, glm::vec3 forward);
+    // Number of jobs of the given type that have not started yet
+    int pendingJobs(TerrainJobType type) const;
+    // Discards every pending job and waits for running jobs to finish.
+    // No jobs are run after this, even if more are submitted.
+    void stop();
+};
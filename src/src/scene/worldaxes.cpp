@@ -20,10 +20,10 @@ void WorldAxes::create()
     mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpq);
     mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(GLuint), idx, GL_STATIC_DRAW);
     generateOpq();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpq);
+    mp_context->bindArrayBuffer(m_bufOpq);
     mp_context->glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(glm::vec4), pos, GL_STATIC_DRAW);
 //    generateCol();
-//    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufCol);
+//    mp_context->bindArrayBuffer(m_bufCol);
 //    mp_context->glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(glm::vec4), col, GL_STATIC_DRAW);
 }
 
@@ -0,0 +1,101 @@
+#include "zonefieldcache.h"
+
+ZoneFieldCache::ZoneFieldCache(const WorldNoise &noise, size_t capacity)
+    : m_noise(noise), m_capacity(capacity), m_entries(), m_clock(0),
+      m_hits(0), m_misses(0), m_dirtStoneMix(nullptr), m_lock(), m_fieldsReady()
+{}
+
+sPtr<const ZoneColumnFields> ZoneFieldCache::get(int xCorner, int zCorner) {
+    int64_t key = toKey(xCorner, zCorner);
+    HeightSamplingMode mode = FBMWorker::getHeightSamplingMode();
+    {
+        QMutexLocker locker(&m_lock);
+        auto it = m_entries.find(key);
+        while (it != m_entries.end() && it->second.mode == mode && it->second.fields == nullptr) {
+            m_fieldsReady.wait(&m_lock);
+            it = m_entries.find(key);
+        }
+        if (it != m_entries.end() && it->second.mode == mode) {
+            it->second.lastUsed = m_clock++;
+            m_hits++;
+            return it->second.fields;
+        }
+        m_misses++;
+        // Claim the zone, so other threads wait for us
+        if (it == m_entries.end()) {
+            evictOldest();
+        }
+        m_entries[key] = Entry{nullptr, mode, m_clock++};
+    }
+
+    // Evaluating a zone takes milliseconds, so don't hold the lock
+    sPtr<const ZoneColumnFields> fields;
+    {
+        WorldNoiseScope noiseScope(m_noise);
+        fields = mkS<ZoneColumnFields>(xCorner, zCorner, mode);
+    }
+
+    QMutexLocker locker(&m_lock);
+    // Unless the sampling mode changed in the meantime
+    // and another thread claimed the zone again
+    auto it = m_entries.find(key);
+    if (it == m_entries.end() || (it->second.mode == mode && it->second.fields == nullptr)) {
+        if (it == m_entries.end()) {
+            evictOldest();
+        }
+        m_entries[key] = Entry{fields, mode, m_clock++};
+    }
+    m_fieldsReady.wakeAll();
+    return fields;
+}
+
+void ZoneFieldCache::evictOldest() {
+    if (m_entries.size() < m_capacity) {
+        return;
+    }
+    // Zones still being evaluated are never evicted
+    auto oldest = m_entries.end();
+    for (auto e = m_entries.begin(); e != m_entries.end(); ++e) {
+        if (e->second.fields != nullptr &&
+                (oldest == m_entries.end() || e->second.lastUsed < oldest->second.lastUsed)) {
+            oldest = e;
+        }
+    }
+    if (oldest != m_entries.end()) {
+        m_entries.erase(oldest);
+    }
+}
+
+sPtr<const ZoneColumnFields> ZoneFieldCache::column(int x, int z, int *index) {
+    int xCorner = static_cast<int>(64.f * glm::floor(x / 64.f));
+    int zCorner = static_cast<int>(64.f * glm::floor(z / 64.f));
+    *index = ZoneColumnFields::columnIndex(x - xCorner, z - zCorner);
+    return get(xCorner, zCorner);
+}
+
+float ZoneFieldCache::surfaceHeight(int x, int z) {
+    int index;
+    sPtr<const ZoneColumnFields> fields = column(x, z, &index);
+    return fields->m_surfaceHeight[index];
+}
+
+uint64_t ZoneFieldCache::hits() const {
+    QMutexLocker locker(&m_lock);
+    return m_hits;
+}
+
+uint64_t ZoneFieldCache::misses() const {
+    QMutexLocker locker(&m_lock);
+    return m_misses;
+}
+
+sPtr<const DirtStoneMixVolume> ZoneFieldCache::dirtStoneMix(MaterialSamplingMode mode) {
+    // Only evaluated once per world and mode, so holding
+    // the lock while doing so costs little
+    QMutexLocker locker(&m_lock);
+    if (m_dirtStoneMix == nullptr || m_dirtStoneMix->m_mode != mode) {
+        WorldNoiseScope noiseScope(m_noise);
+        m_dirtStoneMix = mkS<DirtStoneMixVolume>(mode);
+    }
+    return m_dirtStoneMix;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "chunkworkers.h"
+#include "smartpointerhelp.h"
+#include <QMutex>
+#include <QWaitCondition>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+// How many terrain zones' ZoneColumnFields a ZoneFieldCache keeps.
+// Each takes about 112 KB. This covers every zone within
+// TERRAIN_CREATE_RADIUS (81 of them) with room to move around.
+#define ZONE_FIELD_CACHE_CAPACITY 128
+
+// Keeps the ZoneColumnFields of recently used terrain zones, so
+// the 2D noise fields of a zone are evaluated once and then shared
+// by every pass that needs them: filling the zone's blocks, biome
+// slopes, and queries of the terrain's surface height from the
+// main thread. Zones are keyed by toKey() of their corner, and
+// the least recently used zone is dropped once the cache is full.
+// It also keeps the world's DirtStoneMixVolume, which every Chunk
+// shares. Every method may be called from any thread.
+class ZoneFieldCache {
+private:
+    struct Entry {
+        // Null while another thread is evaluating the zone
+        sPtr<const ZoneColumnFields> fields;
+        // The mode fields was sampled with
+        HeightSamplingMode mode;
+        // Value of m_clock when the entry was last returned
+        uint64_t lastUsed;
+    };
+
+    // The world whose fields are cached
+    WorldNoise m_noise;
+    size_t m_capacity;
+    unordered_map<int64_t, Entry> m_entries;
+    uint64_t m_clock;
+    // Lookups that found their zone, and those that had to evaluate it
+    uint64_t m_hits, m_misses;
+    sPtr<const DirtStoneMixVolume> m_dirtStoneMix;
+    mutable QMutex m_lock;
+    // Woken whenever a zone's fields are added to m_entries
+    QWaitCondition m_fieldsReady;
+
+    // Makes room for one more entry if the cache is full.
+    // Must be called with m_lock held.
+    void evictOldest();
+
+public:
+    ZoneFieldCache(const WorldNoise &noise, size_t capacity = ZONE_FIELD_CACHE_CAPACITY);
+
+    // The fields of the zone with its corner at (xCorner, zCorner),
+    // sampled in FBMWorker's current HeightSamplingMode. Evaluated
+    // on the calling thread if the zone isn't cached. Since every
+    // Chunk of a zone asks for its fields as soon as its FBMWorker
+    // starts, a thread that finds the zone already being evaluated
+    // waits for that instead of evaluating it again.
+    sPtr<const ZoneColumnFields> get(int xCorner, int zCorner);
+    // The fields of the zone containing world-space column (x, z),
+    // and the column's index within them
+    sPtr<const ZoneColumnFields> column(int x, int z, int *index);
+
+    // The height of the generated terrain at world-space column
+    // (x, z), before any blocks are changed. Blocks [0, height) of
+    // the column are solid, and water fills it above that up to
+    // y = 128.
+    float surfaceHeight(int x, int z);
+
+    // The world's DirtStoneMixVolume in the given mode. Evaluated
+    // on the calling thread the first time it is asked for.
+    sPtr<const DirtStoneMixVolume> dirtStoneMix(MaterialSamplingMode mode);
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+};
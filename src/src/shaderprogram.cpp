@@ -4,15 +4,16 @@
 #include <QTextStream>
 #include <QDebug>
 #include <iostream>
+#include <cstring>
 
 
 ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
-      attrPos(-1), attrNor(-1), attrUV(-1), attrCosPow(-1), attrAnim(-1),
+      attrPos(-1), attrNor(-1), attrUV(-1), attrCosPow(-1), attrAnim(-1), attrCol(-1), attrPacked(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifBlockTexture(-1),
       unifSkyTexture(-1), unifScreenDimensions(-1), unifInventorySlotTexture(-1),
-      unifPlayerPos(-1), unifCamAttribs(-1), unifTime(-1),
-      context(context)
+      unifPlayerPos(-1), unifCamAttribs(-1), unifTime(-1), unifChunkOrigin(-1),
+      context(context), m_uniformValues()
 {}
 
 void ShaderProgram::create(const char *vertfile, const char *fragfile)
@@ -21,6 +22,8 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     vertShader = context->glCreateShader(GL_VERTEX_SHADER);
     fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
     prog = context->glCreateProgram();
+    // A new program starts with none of our uniforms set
+    m_uniformValues.clear();
     // Get the body of text stored in our two .glsl files
     QString qVertSource = qTextFileRead(vertfile);
     QString qFragSource = qTextFileRead(fragfile);
@@ -51,6 +54,8 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     // Tell prog that it manages these particular vertex and fragment shaders
     context->glAttachShader(prog, vertShader);
     context->glAttachShader(prog, fragShader);
+    // ChunkMeshArena's VAOs expect packed vertices at a fixed location
+    context->glBindAttribLocation(prog, CHUNK_PACKED_ATTRIB_LOCATION, "vs_Packed");
     context->glLinkProgram(prog);
 
     // Check for linking success
@@ -68,6 +73,7 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     attrCosPow = context->glGetAttribLocation(prog, "vs_CosPow");
     attrAnim   = context->glGetAttribLocation(prog, "vs_Anim");
     attrCol    = context->glGetAttribLocation(prog, "vs_Col");
+    attrPacked = context->glGetAttribLocation(prog, "vs_Packed");
 
     unifModel      = context->glGetUniformLocation(prog, "u_Model");
     unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
@@ -78,19 +84,20 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     unifScreenDimensions = context->glGetUniformLocation(prog, "u_ScreenDimensions");
     unifPlayerPos  = context->glGetUniformLocation(prog, "u_PlayerPos");
     unifTime       = context->glGetUniformLocation(prog, "u_Time");
+    unifChunkOrigin = context->glGetUniformLocation(prog, "u_ChunkOrigin");
     unifCamAttribs = context->glGetUniformLocation(prog, "u_CameraAttribs");
 }
 
 void ShaderProgram::useMe()
 {
-    context->glUseProgram(prog);
+    context->useProgram(prog);
 }
 
 void ShaderProgram::setModelMatrix(const glm::mat4 &model)
 {
     useMe();
 
-    if (unifModel != -1) {
+    if (unifModel != -1 && uniformChanged(unifModel, &model[0][0], sizeof(glm::mat4))) {
         // Pass a 4x4 matrix into a uniform variable in our shader
                         // Handle to the matrix variable on the GPU
         context->glUniformMatrix4fv(unifModel,
@@ -103,7 +110,20 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
     }
 
     if (unifModelInvTr != -1) {
-        glm::mat4 modelinvtr = glm::inverse(glm::transpose(model));
+        glm::mat4 modelinvtr(1.f);
+        if (isTranslation(model)) {
+            // Transposing moves the translation to the bottom
+            // row, and inverting a translation negates it
+            modelinvtr[0][3] = -model[3][0];
+            modelinvtr[1][3] = -model[3][1];
+            modelinvtr[2][3] = -model[3][2];
+        }
+        else {
+            modelinvtr = glm::inverse(glm::transpose(model));
+        }
+        if (!uniformChanged(unifModelInvTr, &modelinvtr[0][0], sizeof(glm::mat4))) {
+            return;
+        }
         // Pass a 4x4 matrix into a uniform variable in our shader
                         // Handle to the matrix variable on the GPU
         context->glUniformMatrix4fv(unifModelInvTr,
@@ -121,7 +141,7 @@ void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
     // Tell OpenGL to use this shader program for subsequent function calls
     useMe();
 
-    if (unifViewProj != -1) {
+    if (unifViewProj != -1 && uniformChanged(unifViewProj, &vp[0][0], sizeof(glm::mat4))) {
     // Pass a 4x4 matrix into a uniform variable in our shader
                     // Handle to the matrix variable on the GPU
     context->glUniformMatrix4fv(unifViewProj,
@@ -136,14 +156,14 @@ void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
 
 void ShaderProgram::setPlayerPos(const glm::vec3 &pp) {
     useMe();
-    if (unifPlayerPos != -1) {
+    if (unifPlayerPos != -1 && uniformChanged(unifPlayerPos, &pp[0], sizeof(glm::vec3))) {
         context->glUniform3f(unifPlayerPos, pp.x, pp.y, pp.z);
     }
 }
 
 void ShaderProgram::setTime(float t) {
     useMe();
-    if (unifTime != -1) {
+    if (unifTime != -1 && uniformChanged(unifTime, &t, sizeof(t))) {
         context->glUniform1f(unifTime, t);
     }
 }
@@ -151,7 +171,7 @@ void ShaderProgram::setTime(float t) {
 void ShaderProgram::setInventorySlotTextureSampler(int slot) {
     useMe();
 
-    if (unifInventorySlotTexture != -1) {
+    if (unifInventorySlotTexture != -1 && uniformChanged(unifInventorySlotTexture, &slot, sizeof(slot))) {
         context->glUniform1i(unifInventorySlotTexture, slot);
     }
 }
@@ -160,7 +180,7 @@ void ShaderProgram::setBlockTextureSampler(int slot)
 {
     useMe();
 
-    if (unifBlockTexture != -1)
+    if (unifBlockTexture != -1 && uniformChanged(unifBlockTexture, &slot, sizeof(slot)))
     {
         context->glUniform1i(unifBlockTexture, slot);
     }
@@ -171,7 +191,7 @@ void ShaderProgram::setSkyTextureSampler(int textureSlot)
 {
     useMe();
 
-    if (unifSkyTexture != -1)
+    if (unifSkyTexture != -1 && uniformChanged(unifSkyTexture, &textureSlot, sizeof(textureSlot)))
     {
         context->glUniform1i(unifSkyTexture, textureSlot);
     }
@@ -179,7 +199,8 @@ void ShaderProgram::setSkyTextureSampler(int textureSlot)
 
 void ShaderProgram::setScreenDimensions(int w, int h) {
     useMe();
-    if (unifScreenDimensions != -1) {
+    glm::ivec2 dimensions(w, h);
+    if (unifScreenDimensions != -1 && uniformChanged(unifScreenDimensions, &dimensions[0], sizeof(dimensions))) {
         context->glUniform2i(unifScreenDimensions, w, h);
     }
 }
@@ -191,16 +212,42 @@ void ShaderProgram::setCamAttribs(const Camera &cam) {
                            glm::vec4(cam.m_up, 0.f),
                            glm::vec4(cam.m_forward, 0.f),
                            glm::vec4(cam.m_position, 0.f)};
+        if (!uniformChanged(unifCamAttribs, &attribs[0][0], sizeof(glm::mat4))) {
+            return;
+        }
         context->glUniformMatrix4fv(unifCamAttribs, 1, GL_FALSE, &attribs[0][0]);
     }
 }
 
+bool ShaderProgram::uniformChanged(int location, const void *value, size_t bytes) {
+    std::vector<unsigned char> &last = m_uniformValues[location];
+    bool changed = last.size() != bytes || std::memcmp(last.data(), value, bytes) != 0;
+    if (changed) {
+        const unsigned char *v = static_cast<const unsigned char*>(value);
+        last.assign(v, v + bytes);
+    }
+    context->countUniformUpload(!changed);
+    return changed;
+}
+
+bool ShaderProgram::isTranslation(const glm::mat4 &m) {
+    return m[0] == glm::vec4(1, 0, 0, 0) && m[1] == glm::vec4(0, 1, 0, 0) &&
+           m[2] == glm::vec4(0, 0, 1, 0) && m[3][3] == 1.f;
+}
+
+void ShaderProgram::setChunkOrigin(const glm::ivec2 &chunk) {
+    useMe();
+    if (unifChunkOrigin != -1 && uniformChanged(unifChunkOrigin, &chunk[0], sizeof(glm::ivec2))) {
+        context->glUniform2i(unifChunkOrigin, chunk.x, chunk.y);
+    }
+}
+
 //This function, as its name implies, uses the passed in GL widget
 void ShaderProgram::draw(Drawable &d, bool opaque, bool testing) {
     useMe();
 
-    if (d.elemCount() < 0) {
-        throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
+    if (d.elemCount(opaque) < 0) {
+        throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount(opaque)) + "!");
     }
 
     bool (Drawable::*bindAppropriateVBO)(void) = &Drawable::bindOpq;
@@ -210,6 +257,12 @@ void ShaderProgram::draw(Drawable &d, bool opaque, bool testing) {
 
 
     if ((d.*bindAppropriateVBO)()) {
+        if (attrPacked != -1) {
+            // Integer attribute, so it must not be converted to float
+            context->glEnableVertexAttribArray(attrPacked);
+            context->glVertexAttribIPointer(attrPacked, CHUNK_VERTEX_WORDS, GL_UNSIGNED_INT,
+                                            CHUNK_VERTEX_WORDS * sizeof(GLuint), static_cast<void*>(0));
+        }
         if (attrPos != -1) {
             context->glEnableVertexAttribArray(attrPos);
             context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 12 * sizeof(float), static_cast<void*>(0));
@@ -234,9 +287,10 @@ void ShaderProgram::draw(Drawable &d, bool opaque, bool testing) {
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
-    d.bindIdx();
-    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, nullptr);
+    d.bindIdx(opaque);
+    context->glDrawElements(d.drawMode(), d.elemCount(opaque), d.idxType(opaque), nullptr);
 
+    if (attrPacked != -1) context->glDisableVertexAttribArray(attrPacked);
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
     if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
@@ -266,7 +320,7 @@ void ShaderProgram::drawScreenSpace(Drawable &d) {
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
-    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, nullptr);
+    context->glDrawElements(d.drawMode(), d.elemCount(), d.idxType(), nullptr);
 
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
@@ -296,7 +350,7 @@ void ShaderProgram::drawWireframe(Drawable &d) {
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
-    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, nullptr);
+    context->glDrawElements(d.drawMode(), d.elemCount(), d.idxType(), nullptr);
 
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
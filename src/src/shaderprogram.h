@@ -7,6 +7,8 @@
 
 #include "drawable.h"
 #include "scene/camera.h"
+#include <unordered_map>
+#include <vector>
 
 
 class ShaderProgram
@@ -22,6 +24,7 @@ public:
     int attrCosPow; // A handle for the "in" vec4 representing vertex color in the vertex shader
     int attrAnim; // A handle for the "in" vec4 representing vertex color in the vertex shader
     int attrCol; // Vertex color
+    int attrPacked; // A handle for the "in" uvec2 holding a packed Chunk vertex (see chunkhelpers.h)
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
     int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse transpose of the model matrix in the vertex shader
@@ -33,13 +36,15 @@ public:
     int unifPlayerPos;
     int unifCamAttribs;
     int unifTime;
+    int unifChunkOrigin; // A handle for the "uniform" ivec2 that packed Chunk vertices are positioned relative to
 
 public:
     ShaderProgram(OpenGLContext* context);
     // Sets up the requisite GL data and shaders from the given .glsl files
     void create(const char *vertfile, const char *fragfile);
 
-    // Tells our OpenGL context to use this shader to draw things
+    // Tells our OpenGL context to use this shader to draw things,
+    // unless it already is
     void useMe();
 
     // Pass the given model matrix to this shader on the GPU
@@ -58,8 +63,14 @@ public:
     void setSkyTextureSampler(int textureSlot);
     void setScreenDimensions(int w, int h);
     void setCamAttribs(const Camera &cam);
-
-    // Interleaved VBO is used to draw all opaque data
+    // Pass the x / 16 and z / 16 of the Chunk that packed
+    // Chunk vertices are positioned relative to
+    void setChunkOrigin(const glm::ivec2 &chunk);
+
+    // Interleaved VBO is used to draw all opaque data.
+    // If this shader reads packed Chunk vertices (vs_Packed),
+    // the VBO is read as CHUNK_VERTEX_WORDS uints per vertex,
+    // otherwise as 12 floats per vertex.
     void draw(Drawable &d, bool opaque, bool testing = false);
 
     // Interleaved VBO is used to draw onto a screen-space
@@ -82,6 +93,16 @@ private:
     OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
                             // from within this class.
+
+    // The last value uploaded to each of our uniforms, by location.
+    // The setters above skip uploading a value a uniform already holds.
+    std::unordered_map<int, std::vector<unsigned char>> m_uniformValues;
+
+    // Records the given bytes as the value of the uniform at location,
+    // and returns whether they differ from what it held before
+    bool uniformChanged(int location, const void *value, size_t bytes);
+    // Whether m only translates, so its inverse transpose is trivial
+    static bool isTranslation(const glm::mat4 &m);
 };
 
 
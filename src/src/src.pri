@@ -22,6 +22,12 @@ SOURCES += \
     $$PWD/scene/noise_functions.cpp \
     $$PWD/scene/blockoutline.cpp \
     $$PWD/scene/chunkworkers.cpp \
+    $$PWD/scene/chunksection.cpp \
+    $$PWD/scene/quadindexbuffer.cpp \
+    $$PWD/scene/terrainjobs.cpp \
+    $$PWD/scene/zonefieldcache.cpp \
+    $$PWD/scene/frustum.cpp \
+    $$PWD/scene/chunkmesharena.cpp \
     $$PWD/inventory_system/inventory.cpp \
     $$PWD/inventory_system/craftingtable.cpp \
     $$PWD/inventory_system/block.cpp
@@ -51,6 +57,12 @@ HEADERS += \
     $$PWD/scene/chunk.h \
     $$PWD/scene/chunkworkers.h \
     $$PWD/scene/chunkhelpers.h \
+    $$PWD/scene/chunksection.h \
+    $$PWD/scene/quadindexbuffer.h \
+    $$PWD/scene/terrainjobs.h \
+    $$PWD/scene/zonefieldcache.h \
+    $$PWD/scene/frustum.h \
+    $$PWD/scene/chunkmesharena.h \
     $$PWD/inventory_system/inventory.h \
     $$PWD/inventory_system/craftingtable.h \
     $$PWD/inventory_system/block.h \
@@ -25,8 +25,7 @@ void Texture::load(GLuint texSlot = 0)
 {
     context->printGLErrorLog();
 
-    context->glActiveTexture(GL_TEXTURE0 + texSlot);
-    context->glBindTexture(GL_TEXTURE_2D, m_textureHandle);
+    context->bindTexture2D(texSlot, m_textureHandle);
 
     // These parameters need to be set for EVERY texture you create
     // They don't always have to be set to the values given here, but they do need
@@ -45,6 +44,5 @@ void Texture::load(GLuint texSlot = 0)
 
 void Texture::bind(GLuint texSlot = 0)
 {
-    context->glActiveTexture(GL_TEXTURE0 + texSlot);
-    context->glBindTexture(GL_TEXTURE_2D, m_textureHandle);
+    context->bindTexture2D(texSlot, m_textureHandle);
 }